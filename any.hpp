@@ -1,35 +1,474 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <memory>
 #include <cstring>
 #include <type_traits>
 #include <typeinfo>
 #include <typeindex>
 #include <cassert>
-#include <sstream>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
 #include <string>
+#include <limits>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <utility>
+#define STATIC_ANY_HAS_IN_PLACE_TYPE 1
+#endif
+
+#if (__cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)) && defined(__has_include)
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define STATIC_ANY_HAS_MEMORY_RESOURCE 1
+#endif
+#endif
+
+// Without exceptions (STATIC_ANY_NO_EXCEPTIONS, or -fno-exceptions), the errors are reported to the failure
+// handler, which aborts by default, and assignments don't back up the previous value anymore
+#if !defined(STATIC_ANY_NO_EXCEPTIONS) && !defined(__cpp_exceptions) && !defined(__EXCEPTIONS) && !defined(_CPPUNWIND)
+#define STATIC_ANY_NO_EXCEPTIONS 1
+#endif
+
+#ifdef STATIC_ANY_NO_EXCEPTIONS
+#define STATIC_ANY_TRY if (true)
+#define STATIC_ANY_CATCH_ALL if (false)
+#define STATIC_ANY_RETHROW
+#else
+#define STATIC_ANY_TRY try
+#define STATIC_ANY_CATCH_ALL catch(...)
+#define STATIC_ANY_RETHROW throw
+#endif
+
+// Everything is declared in an inline namespace named after the exception mode, as the inline functions differ between
+// the modes: modules built in different modes then fail to link together, instead of sharing either definition. The ABI
+// tag also marks the functions only returning a static_any, whose mangled names don't include their return type.
+#ifdef STATIC_ANY_NO_EXCEPTIONS
+#define STATIC_ANY_ABI_NAMESPACE static_any_no_exceptions
+#else
+#define STATIC_ANY_ABI_NAMESPACE static_any_exceptions
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define STATIC_ANY_ABI_TAG __attribute__((abi_tag))
+#else
+#define STATIC_ANY_ABI_TAG
+#endif
+
+inline namespace STATIC_ANY_ABI_TAG STATIC_ANY_ABI_NAMESPACE {
+
+using static_any_failure_handler = void (*)(const std::exception&);
 
 namespace detail { namespace static_any {
 
+#ifdef STATIC_ANY_NO_EXCEPTIONS
+static constexpr bool exceptions = false;
+
+inline void abort_on_failure(const std::exception&)
+{
+	std::abort();
+}
+
+inline std::atomic<static_any_failure_handler>& failure_handler()
+{
+	static std::atomic<static_any_failure_handler> handler{&abort_on_failure};
+	return handler;
+}
+#else
+static constexpr bool exceptions = true;
+#endif
+
+template <class _E>
+[[noreturn]] inline void raise(const _E& e)
+{
+#ifdef STATIC_ANY_NO_EXCEPTIONS
+	failure_handler().load(std::memory_order_acquire)(e);
+	std::abort();
+#else
+	throw e;
+#endif
+}
+
 struct move_tag {};
 struct copy_tag {};
 
-enum class operation_t { query_type, query_size, copy, move, destroy };
+class type_registry;
+
+struct function_table_t
+{
+	const std::type_info* type;
+	std::size_t size;
+	std::size_t alignment;
+	bool trivially_copyable;
+	bool trivially_destructible;
+	bool trivially_relocatable;
+	bool copyable;
+	bool movable;
+	bool nothrow_copy;
+	bool nothrow_move;
+
+	void(*copy)(void* this_ptr, const void* other_ptr);
+	void(*move)(void* this_ptr, void* other_ptr);
+	void(*destroy)(void* this_ptr);
+	// move construction then destruction of the source
+	void(*relocate)(void* this_ptr, void* other_ptr);
+	// id in the registry of the module the table comes from
+	std::uint32_t(*type_id)();
+	type_registry&(*registry)();
+
+	// null when the type isn't copy/move assignable
+	void(*copy_assign)(void* this_ptr, const void* other_ptr);
+	void(*move_assign)(void* this_ptr, void* other_ptr);
+};
+
+using function_ptr_t = const function_table_t*;
+
+// whether the bytes of a value can be copied, or moved, instead of calling the table: a trivially copyable type can
+// still have a deleted copy or move constructor, whose operation raises bad_any_copy
+inline bool bitwise_copyable(function_ptr_t function, copy_tag) { return function->trivially_copyable && function->copyable; }
+inline bool bitwise_copyable(function_ptr_t function, move_tag) { return function->trivially_copyable && function->movable; }
+
+// enough for every scalar type on common ABIs, without padding static_any<N> when N is a multiple of 8
+constexpr std::size_t default_alignment = alignof(double) > alignof(void*) ? alignof(double) : alignof(void*);
+
+// the biggest alignment up to default_alignment that doesn't pad a buffer of _N bytes
+constexpr std::size_t unpadded_alignment(std::size_t n, std::size_t alignment = default_alignment)
+{
+	return alignment == 1 || n % alignment == 0 ? alignment : unpadded_alignment(n, alignment / 2);
+}
+
+// exception guarantee of the assignments of static_any
+struct strong_guarantee {};
+struct basic_guarantee {};
+
+template <class _T>
+struct is_trivially_copyable :
+#if __GNUG__ && __GNUC__ < 5
+	public std::integral_constant<bool, std::has_trivial_copy_constructor<_T>::value>
+#else
+	public std::is_trivially_copyable<_T>
+#endif
+{};
+
+// Assigns dense ids to types on first use, 0 being void. Keyed on std::type_index, so that a type gets the same id in
+// all the modules sharing the registry. A module with its own registry (e.g. a DLL built with hidden visibility) has
+// its own ids: the ids of its tables are resolved again in the registry of the caller.
+class type_registry
+{
+public:
+	static constexpr std::size_t foreign_cache_size = 16;
+
+	static type_registry& instance()
+	{
+		static type_registry registry;
+		return registry;
+	}
+
+	std::uint32_t id(const std::type_info& type)
+	{
+		std::lock_guard<std::mutex> lock(__mutex);
+		return __ids.emplace(std::type_index(type), static_cast<std::uint32_t>(__ids.size())).first->second;
+	}
+
+	// id of the type of a table from another registry. The first tables seen are cached, without locking on lookups:
+	// a slot is published once its id is written. A hit also compares the std::type_info, in case another table was
+	// since loaded at the same address.
+	std::uint32_t foreign_id(function_ptr_t function)
+	{
+		for (const foreign_slot& slot : __foreign)
+		{
+			const function_ptr_t cached = slot.table.load(std::memory_order_acquire);
+			if (cached == nullptr)
+				break;
+			if (cached == function && slot.type == function->type)
+				return slot.id;
+		}
+
+		const std::uint32_t type_id = id(*function->type);
+
+		std::lock_guard<std::mutex> lock(__mutex);
+		for (foreign_slot& slot : __foreign)
+		{
+			if (slot.table.load(std::memory_order_relaxed) == nullptr)
+			{
+				slot.type = function->type;
+				slot.id = type_id;
+				slot.table.store(function, std::memory_order_release);
+				break;
+			}
+		}
+		return type_id;
+	}
+
+private:
+	struct foreign_slot
+	{
+		std::atomic<function_ptr_t> table{nullptr};
+		const std::type_info* type = nullptr;
+		std::uint32_t id = 0;
+	};
+
+	type_registry()
+	{
+		__ids.emplace(std::type_index(typeid(void)), 0);
+	}
+
+	std::mutex __mutex;
+	std::unordered_map<std::type_index, std::uint32_t> __ids;
+	foreign_slot __foreign[foreign_cache_size];
+};
 
-using function_ptr_t = void(*)(operation_t operation, void* this_ptr, void* other_ptr);
+// id of the type of a table in the registry of the calling module
+inline std::uint32_t local_type_id(function_ptr_t function)
+{
+	if (function->registry == &type_registry::instance)
+		return function->type_id();
+	return type_registry::instance().foreign_id(function);
+}
 
 }}
 
-template <std::size_t _N>
+// Dense id of _T in the registry of the calling module, usable as an index in flat tables: static_any::type_id()
+// returns ids of the same registry, also for values coming from other modules. Only the first call per type takes a lock.
+template <class _T>
+inline std::uint32_t type_id_of()
+{
+	static const std::uint32_t id = detail::static_any::type_registry::instance().id(typeid(_T));
+	return id;
+}
+
+// Whether a _T can be moved to another address by a memcpy, the source being then left as raw memory without running
+// its destructor. True for trivially copyable types; it can be specialized for the types known to be trivially
+// relocatable with a given standard library, like std::unique_ptr or std::vector.
+template <class _T>
+struct is_trivially_relocatable :
+	public detail::static_any::is_trivially_copyable<_T>
+{};
+
+namespace detail { namespace static_any {
+
+template <class _T>
+static function_ptr_t get_function_for_type();
+
+// Function tables indexed by their type id, for the containers referring to their table by index rather than by
+// pointer. Lookups don't lock: a table is published before any index to it can be stored. Tables are never removed,
+// so a table coming from a module (DLL) must outlive the values referring to it by index.
+template <class = void>
+class basic_table_registry
+{
+public:
+	static constexpr std::size_t chunk_size = 1024;
+	static constexpr std::size_t max_chunks = 1024;
+
+	static function_ptr_t at(std::uint32_t id)
+	{
+		return __chunks[id / chunk_size].load(std::memory_order_acquire)[id % chunk_size].load(std::memory_order_acquire);
+	}
+
+	// registers the table if its type has none yet, and returns the type id in the registry of this module: a table
+	// from another module is registered under the local id of its type, or shares the slot of a table of that type
+	static std::uint32_t add(function_ptr_t function)
+	{
+		const std::uint32_t id = local_type_id(function);
+		if (id / chunk_size >= max_chunks)
+			raise(std::length_error("too many types referred to by index"));
+
+		std::atomic<function_ptr_t>* chunk = __chunks[id / chunk_size].load(std::memory_order_acquire);
+		if (chunk != nullptr)
+		{
+			const function_ptr_t registered = chunk[id % chunk_size].load(std::memory_order_acquire);
+			if (registered != nullptr)
+				return checked_id(id, registered, function);
+		}
+
+		static std::mutex mutex;
+		std::lock_guard<std::mutex> lock(mutex);
+
+		chunk = __chunks[id / chunk_size].load(std::memory_order_relaxed);
+		if (chunk == nullptr)
+		{
+			chunk = new std::atomic<function_ptr_t>[chunk_size]();
+			__chunks[id / chunk_size].store(chunk, std::memory_order_release);
+		}
+
+		const function_ptr_t registered = chunk[id % chunk_size].load(std::memory_order_relaxed);
+		if (registered != nullptr)
+			return checked_id(id, registered, function);
+
+		chunk[id % chunk_size].store(function, std::memory_order_release);
+		return id;
+	}
+
+private:
+	static std::uint32_t checked_id(std::uint32_t id, function_ptr_t registered, function_ptr_t function)
+	{
+		if (registered != function && registered->type != function->type && std::type_index(*registered->type) != std::type_index(*function->type))
+			raise(std::logic_error("static_any: type id registered for another type"));
+		return id;
+	}
+
+	static std::atomic<std::atomic<function_ptr_t>*> __chunks[max_chunks];
+};
+
+template <class _T>
+std::atomic<std::atomic<function_ptr_t>*> basic_table_registry<_T>::__chunks[basic_table_registry<_T>::max_chunks];
+
+using table_registry = basic_table_registry<>;
+
+// Reference to a function table as its index in the table_registry, used like a function_ptr_t
+template <class _Index>
+class table_index
+{
+	static_assert(std::is_unsigned<_Index>::value && sizeof(_Index) <= sizeof(std::uint32_t), "the index must be an unsigned integer of at most 32 bits");
+
+public:
+	table_index() = default;
+
+	table_index(std::nullptr_t) {}
+
+	table_index(function_ptr_t function) :
+		__index(function ? to_index(table_registry::add(function)) : 0)
+	{}
+
+	template <class _J>
+	table_index(table_index<_J> another) :
+		table_index(static_cast<function_ptr_t>(another))
+	{}
+
+	// the index of the table of _T, registered on the first call only
+	template <class _T>
+	static table_index of()
+	{
+		static const table_index index(get_function_for_type<_T>());
+		return index;
+	}
+
+	operator function_ptr_t() const { return __index == 0 ? nullptr : table_registry::at(__index); }
+
+	function_ptr_t operator->() const
+	{
+		assert(__index != 0);
+		return table_registry::at(__index);
+	}
+
+	explicit operator bool() const { return __index != 0; }
+
+	friend bool operator==(table_index a, table_index b) { return a.__index == b.__index; }
+	friend bool operator!=(table_index a, table_index b) { return a.__index != b.__index; }
+	friend bool operator==(table_index a, std::nullptr_t) { return a.__index == 0; }
+	friend bool operator!=(table_index a, std::nullptr_t) { return a.__index != 0; }
+	friend bool operator==(table_index a, function_ptr_t function) { return static_cast<function_ptr_t>(a) == function; }
+	friend bool operator!=(table_index a, function_ptr_t function) { return static_cast<function_ptr_t>(a) != function; }
+
+private:
+	static _Index to_index(std::uint32_t id)
+	{
+		if (id > std::numeric_limits<_Index>::max())
+			raise(std::length_error("too many types for the index of static_any"));
+		return static_cast<_Index>(id);
+	}
+
+	_Index __index{};
+};
+
+// what static_any stores to refer to its function table: a function_ptr_t, or an index in the table_registry
+template <class _I>
+struct table_ref
+{
+	using type = table_index<_I>;
+
+	template <class _T>
+	static type of() { return type::template of<_T>(); }
+};
+
+template <>
+struct table_ref<function_ptr_t>
+{
+	using type = function_ptr_t;
+
+	template <class _T>
+	static type of() { return get_function_for_type<_T>(); }
+};
+
+// whether two references to function tables, pointers or indexes of any width, refer to the same table: references of
+// the same kind are compared directly
+template <class _Ref>
+inline bool same_table(_Ref a, _Ref b) { return a == b; }
+
+template <class _Ref, class _OtherRef>
+inline bool same_table(_Ref a, _OtherRef b) { return static_cast<function_ptr_t>(a) == static_cast<function_ptr_t>(b); }
+
+}}
+
+#ifdef STATIC_ANY_NO_EXCEPTIONS
+// Replaces the handler called instead of throwing and returns the previous one. The program is aborted if it returns.
+inline static_any_failure_handler set_static_any_failure_handler(static_any_failure_handler handler) noexcept
+{
+	return detail::static_any::failure_handler().exchange(handler, std::memory_order_acq_rel);
+}
+#endif
+
+namespace detail { namespace static_any {
+
+struct access;
+
+template <class _Derived, std::size_t _N, std::size_t _A>
+class spill_storage;
+
+}}
+
+// Tag of the constructors building a value of _T in place from its constructor arguments: std::in_place_type in C++17
+#ifdef STATIC_ANY_HAS_IN_PLACE_TYPE
+using std::in_place_type_t;
+using std::in_place_type;
+#else
+template <class _T>
+struct in_place_type_t
+{
+	explicit in_place_type_t() = default;
+};
+
+template <class _T>
+constexpr in_place_type_t<_T> in_place_type{};
+#endif
+
+namespace detail { namespace static_any {
+
+template <class _T>
+struct is_in_place_type : std::false_type {};
+
+template <class _T>
+struct is_in_place_type<in_place_type_t<_T>> : std::true_type {};
+
+}}
+
+template <class _T>
+class any_cast_result;
+
+template <std::size_t _N,
+		  std::size_t _A = detail::static_any::default_alignment,
+		  class _G = detail::static_any::strong_guarantee,
+		  class _I = detail::static_any::function_ptr_t>
 class static_any
 {
+	static_assert(_A != 0 && (_A & (_A - 1)) == 0, "static_any alignment must be a power of two");
+	static_assert(std::is_same<_G, detail::static_any::strong_guarantee>::value ||
+				  std::is_same<_G, detail::static_any::basic_guarantee>::value, "unknown static_any exception guarantee");
+
 public:
 	template <typename _T>
 	struct is_static_any : public std::false_type {};
 
-	template <std::size_t _M>
-	struct is_static_any<static_any<_M>> : public std::true_type {};
+	template <std::size_t _M, std::size_t _B, class _H, class _J>
+	struct is_static_any<static_any<_M, _B, _H, _J>> : public std::true_type {};
 
 	template <class _T>
 	static constexpr bool is_static_any_v = is_static_any<_T>::value;
@@ -40,16 +479,20 @@ public:
 	~static_any();
 
 	template <class _T,
-			  class = std::enable_if_t<!is_static_any_v<std::decay_t<_T>>>>
+			  class = std::enable_if_t<!is_static_any_v<std::decay_t<_T>> && !detail::static_any::is_in_place_type<std::decay_t<_T>>::value>>
 	static_any(_T&&);
 
+	// builds the value in the buffer, without any temporary: also for non-movable types
+	template <class _T, class... Args>
+	explicit static_any(in_place_type_t<_T>, Args&&... args);
+
 	static_any(const static_any&);
 
-	template <std::size_t _M, class = std::enable_if_t<_M <= _N>>
-	static_any(const static_any<_M>&);
+	template <std::size_t _M, std::size_t _B, class _H, class _J, class = std::enable_if_t<_M <= _N && _B <= _A>>
+	static_any(const static_any<_M, _B, _H, _J>&);
 
-	template <std::size_t _M, class = std::enable_if_t<_M <= _N>>
-	static_any(static_any<_M>&&);
+	template <std::size_t _M, std::size_t _B, class _H, class _J, class = std::enable_if_t<_M <= _N && _B <= _A>>
+	static_any(static_any<_M, _B, _H, _J>&&);
 
 	template <class _T,
 			  class = std::enable_if_t<!is_static_any_v<std::decay_t<_T>>>>
@@ -61,20 +504,25 @@ public:
 		return *this;
 	}
 
-	template <std::size_t _M, class = std::enable_if_t<_M <= _N>>
-	static_any& operator=(const static_any<_M>& any)
+	template <std::size_t _M, std::size_t _B, class _H, class _J, class = std::enable_if_t<_M <= _N && _B <= _A>>
+	static_any& operator=(const static_any<_M, _B, _H, _J>& any)
 	{
 		assign_from_any(any);
 		return *this;
 	}
 
-	template <std::size_t _M, class = std::enable_if_t<_M <= _N>>
-	static_any& operator=(static_any<_M>&& any)
+	template <std::size_t _M, std::size_t _B, class _H, class _J, class = std::enable_if_t<_M <= _N && _B <= _A>>
+	static_any& operator=(static_any<_M, _B, _H, _J>&& any)
 	{
 		assign_from_any(std::move(any));
 		return *this;
 	}
 
+	// assignment from a container of any capacity, checked at runtime: false when the value doesn't fit, leaving this
+	// container unchanged
+	template <class _T, class = std::enable_if_t<is_static_any_v<std::decay_t<_T>>>>
+	bool try_assign(_T&& another);
+
 	void reset();
 
 	template <class _T>
@@ -83,32 +531,69 @@ public:
 	template <class _T>
 	_T& get();
 
+	// non-throwing accessors: nullptr, resp. an empty result holding the stored type, on a type mismatch
+	template <class _T>
+	const _T* get_if() const noexcept;
+
+	template <class _T>
+	_T* get_if() noexcept;
+
+	template <class _T>
+	any_cast_result<const _T> try_get() const noexcept;
+
+	template <class _T>
+	any_cast_result<_T> try_get() noexcept;
+
 	template <class _T>
 	bool has() const;
 
 	const std::type_info& type() const;
 
+	// type_id_of<T>() of the stored type, 0 when empty
+	std::uint32_t type_id() const;
+
 	bool empty() const;
 
 	size_type size() const;
 
 	static constexpr size_type capacity();
 
+	static constexpr size_type alignment();
+
 	template <class _T, class... Args>
 	void emplace(Args&&... args);
 
+	// also with a container of another size, as long as each value fits in the other one: std::length_error otherwise
+	template <std::size_t _M, std::size_t _B, class _H, class _J>
+	void swap(static_any<_M, _B, _H, _J>& another);
+
 private:
-	using operation_t = detail::static_any::operation_t;
 	using function_ptr_t = detail::static_any::function_ptr_t;
+	using table_ref_t = typename detail::static_any::table_ref<_I>::type;
+
+	// the strong guarantee keeps a backup of the previous value while a throwing construction is attempted
+	static constexpr bool backs_up = detail::static_any::exceptions && std::is_same<_G, detail::static_any::strong_guarantee>::value;
 
 	template <class _T>
 	void copy_or_move(_T&& t);
 
+	template <class _T>
+	bool assign_in_place(_T&& t, std::true_type);
+
+	template <class _T>
+	bool assign_in_place(_T&&, std::false_type) { return false; }
+
 	template <class _T>
 	void assign_from_any(_T&&);
 
-	template <std::size_t _M, class CopyOrMoveTag>
-	void assign_from_any(const static_any<_M>&, CopyOrMoveTag);
+	template <std::size_t _M, std::size_t _B, class _H, class _J, class CopyOrMoveTag>
+	void assign_from_any(const static_any<_M, _B, _H, _J>&, CopyOrMoveTag);
+
+	template <std::size_t _M, std::size_t _B, class _H, class _J>
+	bool assign_in_place(const static_any<_M, _B, _H, _J>& another, detail::static_any::copy_tag);
+
+	template <std::size_t _M, std::size_t _B, class _H, class _J>
+	bool assign_in_place(const static_any<_M, _B, _H, _J>& another, detail::static_any::move_tag);
 
 	const std::type_info& query_type() const;
 
@@ -129,160 +614,437 @@ private:
 
 	void call_operation(const function_ptr_t& function, void* this_void_ptr, void* other_void_ptr, detail::static_any::copy_tag);
 
+	template <std::size_t _M, std::size_t _B, class _H, class _J, class CopyOrMoveTag>
+	void copy_or_move_value(const static_any<_M, _B, _H, _J>& another, CopyOrMoveTag);
+
 	template <class _T>
 	void copy_or_move_from_another(_T&&);
 
-	std::array<char, _N> __buff;
-	function_ptr_t __function{};
+	void backup_to(static_any& temp);
 
-	template <std::size_t _S>
+	// a non-movable value can't be backed up: its assignments only offer the basic guarantee
+	bool can_back_up() const { return __function->copyable || __function->movable; }
+
+	static bool can_hold(function_ptr_t function) { return !function || (function->size <= _N && function->alignment <= _A); }
+
+	alignas(_A) std::array<char, _N> __buff;
+	table_ref_t __function{};
+
+	template <std::size_t _S, std::size_t _SA, class _SG, class _SI>
 	friend class static_any;
 
-	template <class _ValueT, std::size_t _S>
-	friend _ValueT* any_cast(static_any<_S>*);
+	friend struct detail::static_any::access;
+
+	template <class _ValueT, std::size_t _S, std::size_t _SA, class _SG, class _SI>
+	friend _ValueT* any_cast(static_any<_S, _SA, _SG, _SI>*);
 
-	template <class _ValueT, std::size_t _S>
-	friend _ValueT& any_cast(static_any<_S>&);
+	template <class _ValueT, std::size_t _S, std::size_t _SA, class _SG, class _SI>
+	friend _ValueT& any_cast(static_any<_S, _SA, _SG, _SI>&);
+
+	template <std::size_t _S, std::size_t _SA, class _SG, class _SI>
+	friend static_any<_S, _SA, _SG, _SI>* uninitialized_relocate(static_any<_S, _SA, _SG, _SI>*, static_any<_S, _SA, _SG, _SI>*, static_any<_S, _SA, _SG, _SI>*);
+};
+
+// Assignments offer the basic guarantee only: the previous value is destroyed before the new one is constructed,
+// without any backup, and the container is left empty if that construction throws
+template <std::size_t _N, std::size_t _A = detail::static_any::default_alignment>
+using static_any_basic = static_any<_N, _A, detail::static_any::basic_guarantee>;
+
+// Refers to its function table by a 16 (or 32) bit index rather than by a pointer, for smaller containers: e.g.
+// static_any_indexed<6> takes 8 bytes. The accesses to the table go through the table registry, an extra load.
+// Indexes are only meaningful in the module which made them: values cross modules with their own registry (e.g. DLLs
+// built with hidden visibility) as static_any, and are converted on each side.
+template <std::size_t _N, std::size_t _A = alignof(std::uint16_t), class _Index = std::uint16_t>
+using static_any_indexed = static_any<_N, _A, detail::static_any::strong_guarantee, _Index>;
+
+// Sized and aligned for the biggest of _Ts, at least to the default alignment
+template <class... _Ts>
+using static_any_for = static_any<std::max({sizeof(_Ts)...}), std::max({detail::static_any::default_alignment, alignof(_Ts)...})>;
+
+// A static_any without copy operations, for move-only values: the containers of static_any_move_only, like std::vector,
+// move their elements when they grow, where they copy a static_any as its move constructor may throw
+template <std::size_t _N, std::size_t _A = detail::static_any::default_alignment>
+class static_any_move_only :
+	public static_any<_N, _A>
+{
+	using base = static_any<_N, _A>;
+
+	template <class _T>
+	using enable_if_value_t = std::enable_if_t<!std::is_base_of<base, std::decay_t<_T>>::value && !detail::static_any::is_in_place_type<std::decay_t<_T>>::value>;
+
+public:
+	static_any_move_only() = default;
+
+	template <class _T, class = enable_if_value_t<_T>>
+	static_any_move_only(_T&& t) :
+		base(std::forward<_T>(t))
+	{}
+
+	template <class _T, class... Args>
+	explicit static_any_move_only(in_place_type_t<_T> tag, Args&&... args) :
+		base(tag, std::forward<Args>(args)...)
+	{}
+
+	static_any_move_only(const static_any_move_only&) = delete;
+	static_any_move_only& operator=(const static_any_move_only&) = delete;
+
+	static_any_move_only(static_any_move_only&& another) :
+		base(static_cast<base&&>(another))
+	{}
+
+	static_any_move_only& operator=(static_any_move_only&& another)
+	{
+		base::operator=(static_cast<base&&>(another));
+		return *this;
+	}
+
+	template <class _T, class = enable_if_value_t<_T>>
+	static_any_move_only& operator=(_T&& t)
+	{
+		base::operator=(std::forward<_T>(t));
+		return *this;
+	}
+};
+
+class bad_any_copy : public std::logic_error
+{
+public:
+	explicit bad_any_copy(const std::type_info& type) :
+		std::logic_error(std::string("static_any: stored type is not copy constructible: ") + type.name()),
+		__type(type)
+	{}
+
+	const std::type_info& stored_type() const { return __type; }
+
+private:
+	const std::type_info& __type;
 };
 
 namespace detail { namespace static_any {
 
-template <class _T>
-static void operation(operation_t operation, void* ptr1, void* ptr2)
+// Trivial copies, moves and destructions only depend on the size of the type: the tables of all the types of a given
+// size share these functions, and only keep their own type information
+template <std::size_t _Size>
+struct trivial_operations
 {
-	_T* this_ptr = reinterpret_cast<_T*>(ptr1);
+	static void copy(void* this_ptr, const void* other_ptr) { std::memcpy(this_ptr, other_ptr, _Size); }
+	static void move(void* this_ptr, void* other_ptr) { std::memcpy(this_ptr, other_ptr, _Size); }
+	static void destroy(void*) {}
+};
 
-	switch(operation)
+template <class _T>
+struct operations
+{
+	static void copy(void* this_ptr, const void* other_ptr)
 	{
-	case operation_t::query_type:
+		assert(this_ptr);
+		assert(other_ptr);
+		do_copy(this_ptr, other_ptr, std::is_copy_constructible<_T>{});
+	}
+
+	static void do_copy(void* this_ptr, const void* other_ptr, std::true_type)
 	{
-		*reinterpret_cast<const std::type_info**>(ptr1) = &typeid(_T);
-		break;
+		new(this_ptr)_T(*reinterpret_cast<const _T*>(other_ptr));
 	}
-	case operation_t::query_size:
+
+	// move-only types are accepted, but copying the any holding them is a runtime error
+	[[noreturn]] static void do_copy(void*, const void*, std::false_type)
 	{
-		*reinterpret_cast<std::size_t*>(ptr1) = sizeof(_T);
-		break;
+		detail::static_any::raise(bad_any_copy(typeid(_T)));
 	}
-	case operation_t::copy:
+
+	static void move(void* this_ptr, void* other_ptr)
 	{
-		_T* other_ptr = reinterpret_cast<_T*>(ptr2);
 		assert(this_ptr);
 		assert(other_ptr);
-		new(this_ptr)_T(*other_ptr);
-		break;
+		do_move(this_ptr, other_ptr, std::is_move_constructible<_T>{});
+	}
+
+	static void do_move(void* this_ptr, void* other_ptr, std::true_type)
+	{
+		new(this_ptr)_T(std::move(*reinterpret_cast<_T*>(other_ptr)));
+	}
+
+	// non-movable types are only built in place, moving the any holding them is a runtime error
+	[[noreturn]] static void do_move(void*, void*, std::false_type)
+	{
+		detail::static_any::raise(bad_any_copy(typeid(_T)));
 	}
-	case operation_t::move:
+
+	static void copy_or_move(void* this_ptr, void* other_ptr, copy_tag) { copy(this_ptr, other_ptr); }
+	static void copy_or_move(void* this_ptr, void* other_ptr, move_tag) { move(this_ptr, other_ptr); }
+
+	static void destroy(void* this_ptr)
 	{
-		_T* other_ptr = reinterpret_cast<_T*>(ptr2);
 		assert(this_ptr);
-		assert(other_ptr);
-		new(this_ptr)_T(std::move(*other_ptr));
-		break;
+		reinterpret_cast<_T*>(this_ptr)->~_T();
+	}
+
+	static void relocate(void* this_ptr, void* other_ptr)
+	{
+		move(this_ptr, other_ptr);
+		destroy(other_ptr);
 	}
-	case operation_t::destroy:
+
+	static void copy_assign(void* this_ptr, const void* other_ptr)
 	{
 		assert(this_ptr);
-		this_ptr->~_T();
-		break;
+		assert(other_ptr);
+		*reinterpret_cast<_T*>(this_ptr) = *reinterpret_cast<const _T*>(other_ptr);
 	}
+
+	static void move_assign(void* this_ptr, void* other_ptr)
+	{
+		assert(this_ptr);
+		assert(other_ptr);
+		*reinterpret_cast<_T*>(this_ptr) = std::move(*reinterpret_cast<_T*>(other_ptr));
 	}
-}
 
-template <class _T>
-static function_ptr_t get_function_for_type()
-{
-	return &static_any::operation<std::remove_cv_t<std::remove_reference_t<_T>>>;
-}
+	using copy_ptr_t = void(*)(void*, const void*);
+	using move_ptr_t = void(*)(void*, void*);
+	using destroy_ptr_t = void(*)(void*);
 
-}}
+	using trivial = trivial_operations<sizeof(_T)>;
 
-template <std::size_t _N>
-static_any<_N>::static_any()
-{}
+	template <bool _Trivial>
+	using trivial_tag = std::integral_constant<bool, _Trivial>;
 
-template <std::size_t _N>
-static_any<_N>::~static_any()
+	// the functions of the table: the shared trivial ones when possible, so that they are only instantiated per type
+	// when they do something specific to it
+	static constexpr copy_ptr_t get_copy(std::true_type) { return &trivial::copy; }
+	static constexpr copy_ptr_t get_copy(std::false_type) { return &operations::copy; }
+
+	static constexpr move_ptr_t get_move(std::true_type) { return &trivial::move; }
+	static constexpr move_ptr_t get_move(std::false_type) { return &operations::move; }
+
+	static constexpr destroy_ptr_t get_destroy(std::true_type) { return &trivial::destroy; }
+	static constexpr destroy_ptr_t get_destroy(std::false_type) { return &operations::destroy; }
+
+	static constexpr move_ptr_t get_relocate(std::true_type) { return &trivial::move; }
+	static constexpr move_ptr_t get_relocate(std::false_type) { return &operations::relocate; }
+
+	static constexpr copy_ptr_t get_copy_assign(std::true_type, std::true_type) { return &trivial::copy; }
+	static constexpr copy_ptr_t get_copy_assign(std::true_type, std::false_type) { return &operations::copy_assign; }
+	static constexpr copy_ptr_t get_copy_assign(std::false_type, std::false_type) { return nullptr; }
+
+	static constexpr move_ptr_t get_move_assign(std::true_type, std::true_type) { return &trivial::move; }
+	static constexpr move_ptr_t get_move_assign(std::true_type, std::false_type) { return &operations::move_assign; }
+	static constexpr move_ptr_t get_move_assign(std::false_type, std::false_type) { return nullptr; }
+
+	// built at compile time: no static initialization, and type()/size() are plain loads
+	static constexpr function_table_t table =
+	{
+		&typeid(_T),
+		sizeof(_T),
+		alignof(_T),
+		is_trivially_copyable<_T>::value,
+		std::is_trivially_destructible<_T>::value,
+		::is_trivially_relocatable<_T>::value,
+		std::is_copy_constructible<_T>::value,
+		std::is_move_constructible<_T>::value,
+		std::is_nothrow_copy_constructible<_T>::value,
+		std::is_nothrow_move_constructible<_T>::value,
+		get_copy(trivial_tag<std::is_trivially_copy_constructible<_T>::value>{}),
+		get_move(trivial_tag<std::is_trivially_move_constructible<_T>::value>{}),
+		get_destroy(trivial_tag<std::is_trivially_destructible<_T>::value>{}),
+		get_relocate(trivial_tag<::is_trivially_relocatable<_T>::value>{}),
+		&type_id_of<_T>,
+		&type_registry::instance,
+		get_copy_assign(std::is_copy_assignable<_T>{}, trivial_tag<std::is_trivially_copy_assignable<_T>::value>{}),
+		get_move_assign(std::is_move_assignable<_T>{}, trivial_tag<std::is_trivially_move_assignable<_T>::value>{})
+	};
+};
+
+template <class _T>
+constexpr function_table_t operations<_T>::table;
+
+template <class _T>
+static function_ptr_t get_function_for_type()
+{
+	return &operations<std::remove_cv_t<std::remove_reference_t<_T>>>::table;
+}
+
+// Tables of _T coming from other modules (e.g. DLLs), already proven to describe _T. Modules must not be unloaded while
+// values of their types are alive; a hit is still checked against the type_info and size of the table, so that a table
+// of another type loaded later at the address of an unloaded one isn't taken for a _T.
+template <class _T>
+struct foreign_tables
+{
+	static constexpr std::size_t size = 4;
+
+	static bool contains(function_ptr_t function)
+	{
+		for (const slot_t& slot : slots)
+		{
+			const function_ptr_t cached = slot.table.load(std::memory_order_acquire);
+			if (cached == nullptr)
+				return false;
+			if (cached == function)
+				return slot.type.load(std::memory_order_acquire) == function->type && function->size == sizeof(_T);
+		}
+		return false;
+	}
+
+	// a full cache just keeps using the slow path for the extra tables
+	static void add(function_ptr_t function)
+	{
+		for (slot_t& slot : slots)
+		{
+			function_ptr_t expected = nullptr;
+			if (slot.table.compare_exchange_strong(expected, function, std::memory_order_acq_rel) || expected == function)
+			{
+				slot.type.store(function->type, std::memory_order_release);
+				return;
+			}
+		}
+	}
+
+	struct slot_t
+	{
+		std::atomic<function_ptr_t> table;
+		std::atomic<const std::type_info*> type;
+	};
+
+	static slot_t slots[size];
+};
+
+template <class _T>
+typename foreign_tables<_T>::slot_t foreign_tables<_T>::slots[foreign_tables<_T>::size];
+
+template <class _T>
+static bool holds_type(function_ptr_t function)
+{
+	using NonConstT = std::remove_cv_t<std::remove_reference_t<_T>>;
+
+	if (function == get_function_for_type<NonConstT>())
+	{
+		return true;
+	}
+	else if (function)
+	{
+		if (foreign_tables<NonConstT>::contains(function))
+			return true;
+
+		// need to try another, possibly more costly way, as we may compare types across DLL boundaries
+		if (std::type_index(typeid(_T)) != std::type_index(*function->type))
+			return false;
+
+		foreign_tables<NonConstT>::add(function);
+		return true;
+	}
+	return false;
+}
+
+}}
+
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+static_any<_N, _A, _G, _I>::static_any()
+{}
+
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+static_any<_N, _A, _G, _I>::~static_any()
 {
 	destroy();
 }
 
-template <std::size_t _N>
+template <std::size_t _N, std::size_t _A, class _G, class _I>
 template <class _T, class>
-static_any<_N>::static_any(_T&& v)
+static_any<_N, _A, _G, _I>::static_any(_T&& v)
 {
 	copy_or_move(std::forward<_T>(v));
 }
 
-template <std::size_t _N>
-static_any<_N>::static_any(const static_any<_N>& another)
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+static_any<_N, _A, _G, _I>::static_any(const static_any<_N, _A, _G, _I>& another)
 {
 	copy_or_move_from_another(another);
 }
 
-template <std::size_t _N>
-template <std::size_t _M, class>
-static_any<_N>::static_any(const static_any<_M>& another)
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+template <std::size_t _M, std::size_t _B, class _H, class _J, class>
+static_any<_N, _A, _G, _I>::static_any(const static_any<_M, _B, _H, _J>& another)
 {
 	copy_or_move_from_another(another);
 }
 
-template <std::size_t _N>
-template <std::size_t _M, class>
-static_any<_N>::static_any(static_any<_M>&& another)
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+template <std::size_t _M, std::size_t _B, class _H, class _J, class>
+static_any<_N, _A, _G, _I>::static_any(static_any<_M, _B, _H, _J>&& another)
 {
 	copy_or_move_from_another(std::move(another));
 }
 
-template <std::size_t _N>
+template <std::size_t _N, std::size_t _A, class _G, class _I>
 template <class _T, class>
-static_any<_N>& static_any<_N>::operator=(_T&& t)
+static_any<_N, _A, _G, _I>& static_any<_N, _A, _G, _I>::operator=(_T&& t)
 {
 	static_assert(capacity() >= sizeof(_T), "_T is too big to be copied to static_any");
+	static_assert(alignment() >= alignof(std::remove_reference_t<_T>), "_T is over-aligned for static_any, use a bigger alignment");
 
 	using NonConstT = std::remove_cv_t<std::remove_reference_t<_T>>;
+	static_assert(std::is_constructible<NonConstT, _T&&>::value, "_T can't be copied or moved to static_any");
+
+	// same type: keep the stored object (and the resources it owns) and assign to it
+	if (assign_in_place(std::forward<_T>(t), std::is_assignable<NonConstT&, _T&&>{}))
+		return *this;
+
 	NonConstT* non_const_t = const_cast<NonConstT*>(&t);
 
-	static_any temp = std::move_if_noexcept(*this);
+	// nothing to restore if the construction can't throw or if there is no previous value
+	if (!backs_up || std::is_nothrow_constructible<NonConstT, _T&&>::value || empty() || !can_back_up())
+	{
+		destroy();
+		call_copy_or_move<_T&&>(__buff.data(), non_const_t);
+		__function = detail::static_any::table_ref<_I>::template of<_T>();
+		return *this;
+	}
+
+	static_any temp;
+	backup_to(temp);
 
-	try
+	STATIC_ANY_TRY
 	{
 		destroy();
 		assert(__function == nullptr);
 
 		call_copy_or_move<_T&&>(__buff.data(), non_const_t);
 	}
-	catch(...)
+	STATIC_ANY_CATCH_ALL
 	{
 		*this = std::move(temp);
-		throw;
+		STATIC_ANY_RETHROW;
 	}
 
-	__function = detail::static_any::get_function_for_type<_T>();
+	__function = detail::static_any::table_ref<_I>::template of<_T>();
 	return *this;
 }
 
-template <std::size_t _N>
-void static_any<_N>::reset() { destroy(); }
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+template <class _T>
+bool static_any<_N, _A, _G, _I>::assign_in_place(_T&& t, std::true_type)
+{
+	using NonConstT = std::remove_cv_t<std::remove_reference_t<_T>>;
 
-template <std::size_t _N>
+	// only the cheap check: a value coming from another module takes the destroy + construct path
+	if (__function != detail::static_any::get_function_for_type<NonConstT>())
+		return false;
+
+	*as<NonConstT>() = std::forward<_T>(t);
+	return true;
+}
+
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+void static_any<_N, _A, _G, _I>::reset() { destroy(); }
+
+template <std::size_t _N, std::size_t _A, class _G, class _I>
 template <class _T>
-bool static_any<_N>::has() const
+bool static_any<_N, _A, _G, _I>::has() const
 {
-	if (__function == detail::static_any::get_function_for_type<_T>())
-	{
-		return true;
-	}
-	else if (__function)
-	{
-		// need to try another, possibly more costly way, as we may compare types across DLL boundaries
-		return std::type_index(typeid(_T)) == std::type_index(query_type());
-	}
-	return false;
+	return detail::static_any::holds_type<_T>(__function);
 }
 
-template <std::size_t _N>
-const std::type_info& static_any<_N>::type() const
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+const std::type_info& static_any<_N, _A, _G, _I>::type() const
 {
 	if (empty())
 		return typeid(void);
@@ -290,11 +1052,17 @@ const std::type_info& static_any<_N>::type() const
 		return query_type();
 }
 
-template <std::size_t _N>
-bool static_any<_N>::empty() const { return __function == nullptr; }
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+std::uint32_t static_any<_N, _A, _G, _I>::type_id() const
+{
+	return empty() ? 0 : detail::static_any::local_type_id(__function);
+}
 
-template <std::size_t _N>
-typename static_any<_N>::size_type static_any<_N>::size() const
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+bool static_any<_N, _A, _G, _I>::empty() const { return __function == nullptr; }
+
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+typename static_any<_N, _A, _G, _I>::size_type static_any<_N, _A, _G, _I>::size() const
 {
 	if (empty())
 		return 0;
@@ -302,44 +1070,62 @@ typename static_any<_N>::size_type static_any<_N>::size() const
 		return query_size();
 }
 
-template <std::size_t _N>
-constexpr typename static_any<_N>::size_type static_any<_N>::capacity()
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+constexpr typename static_any<_N, _A, _G, _I>::size_type static_any<_N, _A, _G, _I>::capacity()
 {
 	return _N;
 }
 
-template <std::size_t _N>
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+constexpr typename static_any<_N, _A, _G, _I>::size_type static_any<_N, _A, _G, _I>::alignment()
+{
+	return _A;
+}
+
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+template <class _T, class... Args>
+static_any<_N, _A, _G, _I>::static_any(in_place_type_t<_T>, Args&&... args)
+{
+	static_assert(capacity() >= sizeof(_T), "_T is too big to be copied to static_any");
+	static_assert(alignment() >= alignof(_T), "_T is over-aligned for static_any, use a bigger alignment");
+
+	new(__buff.data()) _T(std::forward<Args>(args)...);
+	__function = detail::static_any::table_ref<_I>::template of<_T>();
+}
+
+template <std::size_t _N, std::size_t _A, class _G, class _I>
 template <class _T, class... Args>
-void static_any<_N>::emplace(Args&&... args)
+void static_any<_N, _A, _G, _I>::emplace(Args&&... args)
 {
+	static_assert(capacity() >= sizeof(_T), "_T is too big to be copied to static_any");
+	static_assert(alignment() >= alignof(_T), "_T is over-aligned for static_any, use a bigger alignment");
+
 	destroy();
 	new(__buff.data()) _T(std::forward<Args>(args)...);
-	__function = detail::static_any::get_function_for_type<_T>();
+	__function = detail::static_any::table_ref<_I>::template of<_T>();
 }
 
-template <std::size_t _N>
+template <std::size_t _N, std::size_t _A, class _G, class _I>
 template <class _T>
-void static_any<_N>::copy_or_move(_T&& t)
+void static_any<_N, _A, _G, _I>::copy_or_move(_T&& t)
 {
 	static_assert(capacity() >= sizeof(_T), "_T is too big to be copied to static_any");
+	static_assert(alignment() >= alignof(std::remove_reference_t<_T>), "_T is over-aligned for static_any, use a bigger alignment");
 	assert(__function == nullptr);
 
 	using NonConstT = std::remove_cv_t<std::remove_reference_t<_T>>;
+	static_assert(std::is_constructible<NonConstT, _T&&>::value, "_T can't be copied or moved to static_any");
+
 	NonConstT* non_const_t = const_cast<NonConstT*>(&t);
 
-	try {
-		call_copy_or_move<_T&&>(__buff.data(), non_const_t);
-	}
-	catch(...) {
-		throw;
-	}
+	call_copy_or_move<_T&&>(__buff.data(), non_const_t);
 
-	__function = detail::static_any::get_function_for_type<_T>();
+	__function = detail::static_any::table_ref<_I>::template of<_T>();
 }
 
-template <std::size_t _N>
+template <std::size_t _N, std::size_t _A, class _G, class _I>
 template <class _T>
-void static_any<_N>::assign_from_any(_T&& t)
+void static_any<_N, _A, _G, _I>::assign_from_any(_T&& t)
 {
 	using CopyOrMoveTag = typename std::conditional<
 		std::is_rvalue_reference<_T&&>::value,
@@ -350,100 +1136,171 @@ void static_any<_N>::assign_from_any(_T&& t)
 	assign_from_any(std::forward<_T>(t), CopyOrMoveTag{});
 }
 
-template <std::size_t _N>
-template <std::size_t _M, class CopyOrMoveTag>
-void static_any<_N>::assign_from_any(const static_any<_M>& another, CopyOrMoveTag)
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+template <std::size_t _M, std::size_t _B, class _H, class _J, class CopyOrMoveTag>
+void static_any<_N, _A, _G, _I>::assign_from_any(const static_any<_M, _B, _H, _J>& another, CopyOrMoveTag)
 {
+	if (static_cast<const void*>(&another) == this)
+		return;
+
 	if (another.__function == nullptr)
+	{
+		reset();
 		return;
+	}
 
-	static_any temp = std::move_if_noexcept(*this);
-	void* other_data = reinterpret_cast<void*>(const_cast<char*>(another.__buff.data()));
+	if (detail::static_any::same_table(__function, another.__function) && assign_in_place(another, CopyOrMoveTag{}))
+		return;
+
+	const bool nothrow = std::is_same<CopyOrMoveTag, detail::static_any::move_tag>::value ?
+		another.__function->nothrow_move :
+		another.__function->nothrow_copy;
+
+	if (!backs_up || nothrow || empty() || !can_back_up())
+	{
+		destroy();
+		copy_or_move_value(another, CopyOrMoveTag{});
+		__function = another.__function;
+		return;
+	}
+
+	static_any temp;
+	backup_to(temp);
 
-	try {
+	STATIC_ANY_TRY {
 		destroy();
 		assert(__function == nullptr);
 
-		call_operation(another.__function, __buff.data(), other_data, CopyOrMoveTag{});
+		copy_or_move_value(another, CopyOrMoveTag{});
 	}
-	catch(...) {
+	STATIC_ANY_CATCH_ALL {
 		*this = std::move(temp);
-		throw;
+		STATIC_ANY_RETHROW;
 	}
 
 	__function= another.__function;
 }
 
-template <std::size_t _N>
-const std::type_info& static_any<_N>::query_type() const
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+template <class _T, class>
+bool static_any<_N, _A, _G, _I>::try_assign(_T&& another)
+{
+	if (!can_hold(another.__function))
+		return false;
+
+	assign_from_any(std::forward<_T>(another));
+	return true;
+}
+
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+template <std::size_t _M, std::size_t _B, class _H, class _J>
+bool static_any<_N, _A, _G, _I>::assign_in_place(const static_any<_M, _B, _H, _J>& another, detail::static_any::copy_tag)
+{
+	if (!__function->copy_assign)
+		return false;
+
+	__function->copy_assign(__buff.data(), another.__buff.data());
+	return true;
+}
+
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+template <std::size_t _M, std::size_t _B, class _H, class _J>
+bool static_any<_N, _A, _G, _I>::assign_in_place(const static_any<_M, _B, _H, _J>& another, detail::static_any::move_tag)
+{
+	if (!__function->move_assign)
+		return false;
+
+	void* other_data = reinterpret_cast<void*>(const_cast<char*>(another.__buff.data()));
+	__function->move_assign(__buff.data(), other_data);
+	return true;
+}
+
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+const std::type_info& static_any<_N, _A, _G, _I>::query_type() const
 {
 	assert(__function != nullptr);
-	const std::type_info* ti ;
-	__function(operation_t::query_type, &ti, nullptr);
-	return *ti;
+	return *__function->type;
 }
 
-template <std::size_t _N>
-typename static_any<_N>::size_type static_any<_N>::query_size() const
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+typename static_any<_N, _A, _G, _I>::size_type static_any<_N, _A, _G, _I>::query_size() const
 {
 	assert(__function != nullptr);
-	std::size_t size;
-	__function(operation_t::query_size, &size, nullptr);
-	return size;
+	return __function->size;
 }
 
-template <std::size_t _N>
-void static_any<_N>::destroy()
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+void static_any<_N, _A, _G, _I>::destroy()
 {
 	if (__function)
 	{
-		void* not_used = nullptr;
-		__function(operation_t::destroy, __buff.data(), not_used);
+		if (!__function->trivially_destructible)
+			__function->destroy(__buff.data());
 		__function = nullptr;
 	}
 }
 
-template <std::size_t _N>
+template <std::size_t _N, std::size_t _A, class _G, class _I>
 template <class _T>
-const _T* static_any<_N>::as() const
+const _T* static_any<_N, _A, _G, _I>::as() const
 {
 	return reinterpret_cast<const _T*>(__buff.data());
 }
 
-template <std::size_t _N>
+template <std::size_t _N, std::size_t _A, class _G, class _I>
 template <class _T>
-_T* static_any<_N>::as()
+_T* static_any<_N, _A, _G, _I>::as()
 {
 	return reinterpret_cast<_T*>(__buff.data());
 }
 
-template <std::size_t _N>
+template <std::size_t _N, std::size_t _A, class _G, class _I>
 template <class _RefT>
-void static_any<_N>::call_copy_or_move(void* this_void_ptr, void* other_void_ptr)
+void static_any<_N, _A, _G, _I>::call_copy_or_move(void* this_void_ptr, void* other_void_ptr)
 {
 	using Tag = typename std::conditional<std::is_rvalue_reference<_RefT&&>::value,
 				detail::static_any::move_tag,
 				detail::static_any::copy_tag>::type;
 
-	auto function = detail::static_any::get_function_for_type<_RefT>();
-	call_operation(function, this_void_ptr, other_void_ptr, Tag{});
+	// the type is known here: call its operation directly rather than through the function table
+	using NonConstT = std::remove_cv_t<std::remove_reference_t<_RefT>>;
+	detail::static_any::operations<NonConstT>::copy_or_move(this_void_ptr, other_void_ptr, Tag{});
 }
 
-template <std::size_t _N>
-void static_any<_N>::call_operation(const function_ptr_t& function, void* this_void_ptr, void* other_void_ptr, detail::static_any::move_tag)
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+void static_any<_N, _A, _G, _I>::call_operation(const function_ptr_t& function, void* this_void_ptr, void* other_void_ptr, detail::static_any::move_tag)
 {
-	function(operation_t::move, this_void_ptr, other_void_ptr);
+	function->move(this_void_ptr, other_void_ptr);
 }
 
-template <std::size_t _N>
-void static_any<_N>::call_operation(const function_ptr_t& function, void* this_void_ptr, void* other_void_ptr, detail::static_any::copy_tag)
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+void static_any<_N, _A, _G, _I>::call_operation(const function_ptr_t& function, void* this_void_ptr, void* other_void_ptr, detail::static_any::copy_tag)
 {
-	function(operation_t::copy, this_void_ptr, other_void_ptr);
+	function->copy(this_void_ptr, other_void_ptr);
 }
 
-template <std::size_t _N>
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+template <std::size_t _M, std::size_t _B, class _H, class _J, class CopyOrMoveTag>
+void static_any<_N, _A, _G, _I>::copy_or_move_value(const static_any<_M, _B, _H, _J>& another, CopyOrMoveTag)
+{
+	assert(another.__function != nullptr);
+
+	if (detail::static_any::bitwise_copyable(another.__function, CopyOrMoveTag{}))
+	{
+		// fixed size copy of the whole buffer, cheaper than an indirect call. A bigger buffer is only copied from when
+		// its value was checked to fit.
+		std::memcpy(__buff.data(), another.__buff.data(), _M < _N ? _M : _N);
+	}
+	else
+	{
+		void* other_data = reinterpret_cast<void*>(const_cast<char*>(another.__buff.data()));
+		call_operation(another.__function, __buff.data(), other_data, CopyOrMoveTag{});
+	}
+}
+
+template <std::size_t _N, std::size_t _A, class _G, class _I>
 template <class _T>
-void static_any<_N>::copy_or_move_from_another(_T&& another)
+void static_any<_N, _A, _G, _I>::copy_or_move_from_another(_T&& another)
 {
 	assert(__function == nullptr);
 
@@ -456,57 +1313,287 @@ void static_any<_N>::copy_or_move_from_another(_T&& another)
 				detail::static_any::move_tag,
 				detail::static_any::copy_tag>::type;
 
-	void* other_data = reinterpret_cast<void*>(const_cast<char*>(another.__buff.data()));
+	copy_or_move_value(another, Tag{});
+
+	__function= another.__function;
+}
+
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+void static_any<_N, _A, _G, _I>::backup_to(static_any& temp)
+{
+	assert(__function != nullptr);
+
+	// std::move_if_noexcept applied to the stored type, which isn't known at compile time
+	if (__function->nothrow_move || !__function->copyable)
+		temp.copy_or_move_from_another(std::move(*this));
+	else
+		temp.copy_or_move_from_another(*this);
+}
+
+// Moves the values of [first, last) to the uninitialized memory at d_first, and leaves [first, last) as raw memory,
+// without running its destructors. Runs of empty and trivially relocatable values are moved by a single memcpy, the
+// other values by their relocate operation. If that operation throws, both ranges are destroyed before rethrowing.
+template <std::size_t _S, std::size_t _SA, class _SG, class _SI>
+inline static_any<_S, _SA, _SG, _SI>* uninitialized_relocate(static_any<_S, _SA, _SG, _SI>* first, static_any<_S, _SA, _SG, _SI>* last, static_any<_S, _SA, _SG, _SI>* d_first)
+{
+	using any_t = static_any<_S, _SA, _SG, _SI>;
+
+	any_t* const d_begin = d_first;
+	while (first != last)
+	{
+		any_t* run_end = first;
+		while (run_end != last && (!run_end->__function || run_end->__function->trivially_relocatable))
+			++run_end;
+
+		if (run_end != first)
+		{
+			const std::size_t count = static_cast<std::size_t>(run_end - first);
+			std::memcpy(static_cast<void*>(d_first), static_cast<const void*>(first), count * sizeof(any_t));
+			d_first += count;
+			first = run_end;
+			continue;
+		}
+
+		any_t* target = new(static_cast<void*>(d_first)) any_t();
+		STATIC_ANY_TRY
+		{
+			first->__function->relocate(target->__buff.data(), first->__buff.data());
+		}
+		STATIC_ANY_CATCH_ALL
+		{
+			for (any_t* it = d_begin; it != d_first; ++it)
+				it->~any_t();
+			for (; first != last; ++first)
+				first->~any_t();
+			STATIC_ANY_RETHROW;
+		}
+		target->__function = first->__function;
+		++d_first;
+		++first;
+	}
+	return d_first;
+}
+
+template <std::size_t _N, std::size_t _A, class _G, class _I>
+template <std::size_t _M, std::size_t _B, class _H, class _J>
+void static_any<_N, _A, _G, _I>::swap(static_any<_M, _B, _H, _J>& another)
+{
+	if (static_cast<const void*>(this) == static_cast<const void*>(&another))
+		return;
 
-	try {
-		call_operation(another.__function, __buff.data(), other_data, Tag{});
+	const function_ptr_t function = __function;
+	const function_ptr_t other_function = another.__function;
+
+	if (!another.can_hold(function) || !can_hold(other_function))
+		detail::static_any::raise(std::length_error("static_any: value too big to be swapped"));
+
+	if ((!function || function->trivially_relocatable) && (!other_function || other_function->trivially_relocatable))
+	{
+		// fixed size swap of the buffers, both values fitting in the smallest one
+		constexpr std::size_t size = _N < _M ? _N : _M;
+		std::array<char, size> temp;
+		std::memcpy(temp.data(), __buff.data(), size);
+		std::memcpy(__buff.data(), another.__buff.data(), size);
+		std::memcpy(another.__buff.data(), temp.data(), size);
 	}
-	catch(...) {
-		throw;
+	else
+	{
+		// three relocations through a temporary buffer. If one of them throws, the value being relocated is kept
+		// unless it was in the temporary buffer: then it is destroyed and its container is left empty.
+		alignas(_A > _B ? _A : _B) std::array<char, _N < _M ? _M : _N> temp;
+		if (function)
+			function->relocate(temp.data(), __buff.data());
+
+		STATIC_ANY_TRY
+		{
+			if (other_function)
+				other_function->relocate(__buff.data(), another.__buff.data());
+		}
+		STATIC_ANY_CATCH_ALL
+		{
+			if (function)
+				function->destroy(temp.data());
+			__function = nullptr;
+			STATIC_ANY_RETHROW;
+		}
+
+		STATIC_ANY_TRY
+		{
+			if (function)
+				function->relocate(another.__buff.data(), temp.data());
+		}
+		STATIC_ANY_CATCH_ALL
+		{
+			function->destroy(temp.data());
+			__function = other_function;
+			another.__function = nullptr;
+			STATIC_ANY_RETHROW;
+		}
 	}
 
-	__function= another.__function;
+	__function = other_function;
+	another.__function = function;
+}
+
+// A static_any<_S> holding a _T built in place, by default just big enough for it
+template <class _T, std::size_t _S = sizeof(_T), class... Args>
+inline static_any<_S, std::max(detail::static_any::default_alignment, alignof(_T))> make_static_any(Args&&... args)
+{
+	return static_any<_S, std::max(detail::static_any::default_alignment, alignof(_T))>(in_place_type<_T>, std::forward<Args>(args)...);
+}
+
+// Copy, or move, of the value of a static_any to a smaller one, as long as the value fits: false otherwise, leaving
+// both containers unchanged
+template <class _From, std::size_t _S, std::size_t _SA, class _SG, class _SI>
+inline bool try_narrow(_From&& from, static_any<_S, _SA, _SG, _SI>& to)
+{
+	return to.try_assign(std::forward<_From>(from));
+}
+
+// Same as try_narrow, raising std::length_error when the value doesn't fit
+template <class _Any, class _From>
+inline _Any narrow_cast(_From&& from)
+{
+	_Any to;
+	if (!to.try_assign(std::forward<_From>(from)))
+		detail::static_any::raise(std::length_error("static_any: value too big to be narrowed"));
+	return to;
+}
+
+template <std::size_t _S, std::size_t _SA, class _SG, class _SI>
+inline void swap(static_any<_S, _SA, _SG, _SI>& a, static_any<_S, _SA, _SG, _SI>& b)
+{
+	a.swap(b);
+}
+
+template <std::size_t _S, std::size_t _SA, class _SG, class _SI, std::size_t _M, std::size_t _B, class _H, class _J>
+inline void swap(static_any<_S, _SA, _SG, _SI>& a, static_any<_M, _B, _H, _J>& b)
+{
+	a.swap(b);
 }
 
 class bad_any_cast : public std::bad_cast
 {
 public:
 	explicit bad_any_cast(const std::type_info& from,
-						  const std::type_info& to);
-	virtual ~bad_any_cast();
+						  const std::type_info& to) noexcept :
+		__from(from),
+		__to(to)
+	{}
 
 	const std::type_info& stored_type() const { return __from; }
 	const std::type_info& target_type() const { return __to; }
 
+	bad_any_cast(const bad_any_cast& another) noexcept :
+		std::bad_cast(another),
+		__from(another.__from),
+		__to(another.__to),
+		__reason(acquire(another.__reason.load(std::memory_order_acquire)))
+	{}
+
+	bad_any_cast& operator=(const bad_any_cast&) = delete;
+
+	~bad_any_cast() override
+	{
+		release(__reason.load(std::memory_order_acquire));
+	}
+
+	// the message is only built on the first call, so that throwing costs no formatting. It is published atomically,
+	// as threads may share the exception, and shared with the copies made afterwards.
 	const char* what() const noexcept override
 	{
-		return __reason.c_str();
+		reason* built = __reason.load(std::memory_order_acquire);
+		if (built == nullptr)
+		{
+			STATIC_ANY_TRY
+			{
+				std::unique_ptr<reason> candidate(new reason);
+				candidate->text = std::string("failed conversion using any_cast: stored type ")
+					+ __from.name()
+					+ ", trying to cast to "
+					+ __to.name();
+
+				if (__reason.compare_exchange_strong(built, candidate.get(), std::memory_order_acq_rel, std::memory_order_acquire))
+					built = candidate.release();
+			}
+			STATIC_ANY_CATCH_ALL
+			{
+				return "failed conversion using any_cast";
+			}
+		}
+		return built->text.c_str();
 	}
 
 private:
+	struct reason
+	{
+		std::atomic<unsigned> references{1};
+		std::string text;
+	};
+
+	static reason* acquire(reason* r) noexcept
+	{
+		if (r != nullptr)
+			r->references.fetch_add(1, std::memory_order_relaxed);
+		return r;
+	}
+
+	static void release(reason* r) noexcept
+	{
+		if (r != nullptr && r->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			delete r;
+	}
+
 	const std::type_info& __from;
 	const std::type_info& __to;
-	std::string __reason;
+	mutable std::atomic<reason*> __reason{nullptr};
 };
 
-bad_any_cast::bad_any_cast(const std::type_info& from,
-						   const std::type_info& to) :
-	__from(from),
-	__to(to)
+static_assert(std::is_nothrow_copy_constructible<bad_any_cast>::value, "exceptions must be nothrow copy constructible");
+
+// Either a pointer to the stored value, or the type actually stored (void when empty)
+template <class _T>
+class any_cast_result
 {
-	std::ostringstream oss;
-	oss << "failed conversion using any_cast: stored type "
-		<< from.name()
-		<< ", trying to cast to "
-		<< to.name();
-	__reason = oss.str();
-}
+public:
+	any_cast_result(_T* value, const std::type_info& stored) noexcept :
+		__value(value),
+		__stored(&stored)
+	{}
+
+	bool has_value() const noexcept { return __value != nullptr; }
+	explicit operator bool() const noexcept { return has_value(); }
+
+	_T& operator*() const noexcept { assert(has_value()); return *__value; }
+	_T* operator->() const noexcept { assert(has_value()); return __value; }
 
-bad_any_cast::~bad_any_cast() {}
+	_T& value() const
+	{
+		if (!has_value())
+			detail::static_any::raise(bad_any_cast(*__stored, typeid(_T)));
+		return *__value;
+	}
+
+	template <class _U>
+	std::remove_cv_t<_T> value_or(_U&& default_value) const
+	{
+		return has_value() ? *__value : static_cast<std::remove_cv_t<_T>>(std::forward<_U>(default_value));
+	}
+
+	// the stored type, only meaningful when there is no value
+	const std::type_info& error() const noexcept { return *__stored; }
+
+private:
+	_T* __value;
+	const std::type_info* __stored;
+};
 
 template <class _ValueT,
-		  std::size_t _S>
-inline _ValueT* any_cast(static_any<_S>* a)
+		  std::size_t _S,
+		  std::size_t _SA,
+		  class _SG,
+		  class _SI>
+inline _ValueT* any_cast(static_any<_S, _SA, _SG, _SI>* a)
 {
 	if (!a->template has<_ValueT>())
 		return nullptr;
@@ -515,73 +1602,278 @@ inline _ValueT* any_cast(static_any<_S>* a)
 }
 
 template <class _ValueT,
-		  std::size_t _S>
-inline const _ValueT* any_cast(const static_any<_S>* a)
+		  std::size_t _S,
+		  std::size_t _SA,
+		  class _SG,
+		  class _SI>
+inline const _ValueT* any_cast(const static_any<_S, _SA, _SG, _SI>* a)
 {
-	return any_cast<const _ValueT>(const_cast<static_any<_S>*>(a));
+	return any_cast<const _ValueT>(const_cast<static_any<_S, _SA, _SG, _SI>*>(a));
 }
 
 template <class _ValueT,
-		  std::size_t _S>
-inline _ValueT& any_cast(static_any<_S>& a)
+		  std::size_t _S,
+		  std::size_t _SA,
+		  class _SG,
+		  class _SI>
+inline _ValueT& any_cast(static_any<_S, _SA, _SG, _SI>& a)
 {
 	if (!a.template has<_ValueT>())
-		throw bad_any_cast(a.type(), typeid(_ValueT));
+		detail::static_any::raise(bad_any_cast(a.type(), typeid(_ValueT)));
 
 	return *a.template as<_ValueT>();
 }
 
 template <class _ValueT,
-		  std::size_t _S>
-inline const _ValueT& any_cast(const static_any<_S>& a)
+		  std::size_t _S,
+		  std::size_t _SA,
+		  class _SG,
+		  class _SI>
+inline const _ValueT& any_cast(const static_any<_S, _SA, _SG, _SI>& a)
 {
-	return any_cast<const _ValueT>(const_cast<static_any<_S>&>(a));
+	return any_cast<const _ValueT>(const_cast<static_any<_S, _SA, _SG, _SI>&>(a));
 }
 
-template <std::size_t _S>
+template <std::size_t _S, std::size_t _SA, class _SG, class _SI>
 template <class _T>
-const _T& static_any<_S>::get() const
+const _T& static_any<_S, _SA, _SG, _SI>::get() const
 {
 	return any_cast<_T>(*this);
 }
 
-template <std::size_t _S>
+template <std::size_t _S, std::size_t _SA, class _SG, class _SI>
 template <class _T>
-_T& static_any<_S>::get()
+_T& static_any<_S, _SA, _SG, _SI>::get()
 {
 	return any_cast<_T>(*this);
 }
 
+template <std::size_t _S, std::size_t _SA, class _SG, class _SI>
+template <class _T>
+const _T* static_any<_S, _SA, _SG, _SI>::get_if() const noexcept
+{
+	return any_cast<_T>(this);
+}
 
-template <std::size_t _N>
-class static_any_t
+template <std::size_t _S, std::size_t _SA, class _SG, class _SI>
+template <class _T>
+_T* static_any<_S, _SA, _SG, _SI>::get_if() noexcept
 {
-public:
-	using size_type = std::size_t;
+	return any_cast<_T>(this);
+}
 
-	static constexpr size_type capacity() { return _N; }
+template <std::size_t _S, std::size_t _SA, class _SG, class _SI>
+template <class _T>
+any_cast_result<const _T> static_any<_S, _SA, _SG, _SI>::try_get() const noexcept
+{
+	return any_cast_result<const _T>(get_if<_T>(), type());
+}
 
-	static_any_t() = default;
-	static_any_t(const static_any_t&) = default;
+template <std::size_t _S, std::size_t _SA, class _SG, class _SI>
+template <class _T>
+any_cast_result<_T> static_any<_S, _SA, _SG, _SI>::try_get() noexcept
+{
+	return any_cast_result<_T>(get_if<_T>(), type());
+}
 
-	template <class _ValueT>
-	static_any_t(_ValueT&& t)
-	{
-		copy(std::forward<_ValueT>(t));
-	}
 
-	template <class _ValueT>
-	static_any_t& operator=(_ValueT&& t)
-	{
-		copy(std::forward<_ValueT>(t));
-		return *this;
-	}
+namespace detail { namespace static_any {
 
-	template <class _ValueT>
-	_ValueT& get() { return *reinterpret_cast<_ValueT*>(__buff.data()); }
+// unchecked access to the stored value, for callers which already identified its type
+struct access
+{
+	template <class _T, std::size_t _S, std::size_t _SA, class _SG, class _SI>
+	static _T* as(::static_any<_S, _SA, _SG, _SI>& any) { return any.template as<_T>(); }
+
+	template <class _T, std::size_t _S, std::size_t _SA, class _SG, class _SI>
+	static const _T* as(const ::static_any<_S, _SA, _SG, _SI>& any) { return any.template as<_T>(); }
+
+	template <class _T, class _D, std::size_t _S, std::size_t _SA>
+	static _T* as(spill_storage<_D, _S, _SA>& storage) { return storage.template as<_T>(); }
+
+	template <class _T, class _D, std::size_t _S, std::size_t _SA>
+	static const _T* as(const spill_storage<_D, _S, _SA>& storage) { return storage.template as<_T>(); }
+};
+
+// 1-based position of the type with the given id in _Ts, 0 if not in _Ts: a single load in a table built on first use
+template <class... _Ts>
+inline std::size_t position_of_type_id(std::uint32_t type_id)
+{
+	static const std::vector<std::uint16_t> positions = []()
+	{
+		const std::uint32_t ids[] = { type_id_of<_Ts>()... };
+		std::vector<std::uint16_t> table(*std::max_element(std::begin(ids), std::end(ids)) + 1, 0);
+
+		for (std::size_t i = sizeof...(_Ts); i > 0; --i)
+			table[ids[i - 1]] = static_cast<std::uint16_t>(i);
+		return table;
+	}();
+
+	return type_id < positions.size() ? positions[type_id] : 0;
+}
+
+template <class... _Ts>
+inline const std::type_info& type_at_position(std::size_t position)
+{
+	static const std::type_info* const types[] = { &typeid(_Ts)... };
+	return *types[position - 1];
+}
+
+template <class _R, class _T, class _Any, class _Visitor>
+_R visit_as(_Any& any, _Visitor& visitor)
+{
+	return visitor(*access::as<_T>(any));
+}
+
+template <class _R, class... _Ts, class _Any, class _Visitor>
+_R dispatch_visit(_Any& any, _Visitor& visitor)
+{
+	static_assert(sizeof...(_Ts) > 0 && sizeof...(_Ts) < 65536, "visit needs between 1 and 65535 types");
+
+	using handler_t = _R(*)(_Any&, _Visitor&);
+	static constexpr handler_t handlers[] = { &visit_as<_R, _Ts, _Any, _Visitor>... };
+
+	// type_id() is resolved in the registry of this module, as the positions
+	const std::size_t position = position_of_type_id<_Ts...>(any.type_id());
+	if (position == 0)
+		return visitor();
+
+	assert(type_at_position<_Ts...>(position) == any.type());
+	return handlers[position - 1](any, visitor);
+}
+
+template <class... _Fs>
+struct overloaded;
+
+template <class _F>
+struct overloaded<_F> : _F
+{
+	overloaded(_F f) : _F(std::move(f)) {}
+
+	using _F::operator();
+};
+
+template <class _F, class... _Fs>
+struct overloaded<_F, _Fs...> : _F, overloaded<_Fs...>
+{
+	overloaded(_F f, _Fs... fs) : _F(std::move(f)), overloaded<_Fs...>(std::move(fs)...) {}
+
+	using _F::operator();
+	using overloaded<_Fs...>::operator();
+};
+
+}}
+
+// Calls visitor(value) with the stored value if its type is one of _Ts, visitor() otherwise (unknown type or empty).
+// The stored type is resolved to its position in _Ts with a single table lookup on its type id, resolved in the
+// registry of the calling module whichever module created the value, and the handler is called through a jump table.
+// The return type is the one of visitor().
+template <class... _Ts, std::size_t _S, std::size_t _SA, class _SG, class _SI, class _Visitor>
+inline decltype(auto) visit(static_any<_S, _SA, _SG, _SI>& any, _Visitor&& visitor)
+{
+	return detail::static_any::dispatch_visit<decltype(visitor()), _Ts...>(any, visitor);
+}
+
+template <class... _Ts, std::size_t _S, std::size_t _SA, class _SG, class _SI, class _Visitor>
+inline decltype(auto) visit(const static_any<_S, _SA, _SG, _SI>& any, _Visitor&& visitor)
+{
+	return detail::static_any::dispatch_visit<decltype(visitor()), _Ts...>(any, visitor);
+}
+
+// Builds a visitor from several lambdas, like the usual C++17 overloaded{...}
+template <class... _Fs>
+inline detail::static_any::overloaded<std::decay_t<_Fs>...> make_visitor(_Fs&&... fs)
+{
+	return detail::static_any::overloaded<std::decay_t<_Fs>...>(std::forward<_Fs>(fs)...);
+}
+
+// static_any_t checks the requested type in get() when STATIC_ANY_T_CHECKED is defined, unless NDEBUG is defined too
+#if defined(STATIC_ANY_T_CHECKED) && !defined(NDEBUG)
+#define STATIC_ANY_T_CHECKED_BY_DEFAULT true
+#else
+#define STATIC_ANY_T_CHECKED_BY_DEFAULT false
+#endif
+
+namespace detail { namespace static_any {
+
+// Type of the value stored in a static_any_t, only kept by the checked ones: the unchecked tag is an empty base
+template <bool _Checked>
+struct type_tag
+{
+	void set(function_ptr_t) {}
+
+	template <class _T>
+	void check() const {}
+};
+
+template <>
+struct type_tag<true>
+{
+	void set(function_ptr_t function) { __function = function; }
+
+	template <class _T>
+	void check() const
+	{
+		assert(holds_type<_T>(__function) && "static_any_t doesn't hold the requested type");
+	}
+
+	function_ptr_t __function{};
+};
+
+}}
+
+template <std::size_t _N, std::size_t _A = detail::static_any::unpadded_alignment(_N), bool _Checked = STATIC_ANY_T_CHECKED_BY_DEFAULT>
+class static_any_t : private detail::static_any::type_tag<_Checked>
+{
+	static_assert(_A != 0 && (_A & (_A - 1)) == 0, "static_any_t alignment must be a power of two");
+
+	template <class _ValueT>
+	using enable_if_value_t = std::enable_if_t<!std::is_same<std::decay_t<_ValueT>, static_any_t>::value>;
+
+public:
+	using size_type = std::size_t;
+
+	static constexpr size_type capacity() { return _N; }
+	static constexpr size_type alignment() { return _A; }
+
+	static_any_t() = default;
+	static_any_t(const static_any_t&) = default;
+	static_any_t& operator=(const static_any_t&) = default;
+
+	template <class _ValueT, class = enable_if_value_t<_ValueT>>
+	static_any_t(_ValueT&& t)
+	{
+		copy(std::forward<_ValueT>(t));
+	}
+
+	template <class _ValueT, class = enable_if_value_t<_ValueT>>
+	static_any_t& operator=(_ValueT&& t)
+	{
+		copy(std::forward<_ValueT>(t));
+		return *this;
+	}
+
+	template <class _ValueT>
+	_ValueT& get()
+	{
+		this->template check<_ValueT>();
+		return *reinterpret_cast<_ValueT*>(__buff.data());
+	}
 
 	template <class _ValueT>
-	const _ValueT& get() const { return *reinterpret_cast<const _ValueT*>(__buff.data()); }
+	const _ValueT& get() const
+	{
+		this->template check<_ValueT>();
+		return *reinterpret_cast<const _ValueT*>(__buff.data());
+	}
+
+	// trivially copyable: three fixed size copies, rather than three assignments
+	void swap(static_any_t& another) noexcept
+	{
+		const static_any_t temp(another);
+		another = *this;
+		*this = temp;
+	}
 
 private:
 	template <class _ValueT>
@@ -589,16 +1881,1819 @@ private:
 	{
 		using NonConstT = std::remove_cv_t<std::remove_reference_t<_ValueT>>;
 
-#if __GNUG__ && __GNUC__ < 5
-		static_assert(std::has_trivial_copy_constructor<NonConstT>::value, "_ValueT is not trivially copyable");
-#else
-		static_assert(std::is_trivially_copyable<NonConstT>::value, "_ValueT is not trivially copyable");
-#endif
+		static_assert(detail::static_any::is_trivially_copyable<NonConstT>::value, "_ValueT is not trivially copyable");
 
 		static_assert(capacity() >= sizeof(_ValueT), "_ValueT is too big to be copied to static_any");
+		static_assert(alignment() >= alignof(NonConstT), "_ValueT is over-aligned for static_any_t, use a bigger alignment");
 
 		std::memcpy(__buff.data(), reinterpret_cast<char*>(&t), sizeof(_ValueT));
+		this->set(detail::static_any::get_function_for_type<NonConstT>());
+	}
+
+	alignas(_A) std::array<char, _N> __buff;
+};
+
+template <std::size_t _S, std::size_t _SA, bool _SChecked>
+inline void swap(static_any_t<_S, _SA, _SChecked>& a, static_any_t<_S, _SA, _SChecked>& b) noexcept
+{
+	a.swap(b);
+}
+
+namespace detail { namespace static_any {
+
+// smallest unsigned type holding _N
+template <std::size_t _N>
+using size_for_t = std::conditional_t<_N <= std::numeric_limits<std::uint8_t>::max(), std::uint8_t,
+				   std::conditional_t<_N <= std::numeric_limits<std::uint16_t>::max(), std::uint16_t, std::uint32_t>>;
+
+}}
+
+// Like static_any_t, but the size of the stored value is recorded (on 1 byte up to 255, 2 bytes up to 65535),
+// so that copies only move the stored bytes rather than the whole buffer
+template <std::size_t _N, std::size_t _A = detail::static_any::default_alignment>
+class static_any_sized_t
+{
+	static_assert(_A != 0 && (_A & (_A - 1)) == 0, "static_any_sized_t alignment must be a power of two");
+
+	template <class _ValueT>
+	using enable_if_value_t = std::enable_if_t<!std::is_same<std::decay_t<_ValueT>, static_any_sized_t>::value>;
+
+public:
+	using size_type = std::size_t;
+
+	static constexpr size_type capacity() { return _N; }
+	static constexpr size_type alignment() { return _A; }
+
+	static_any_sized_t() = default;
+
+	static_any_sized_t(const static_any_sized_t& another) :
+		__size(another.__size)
+	{
+		copy_prefix(__buff.data(), another.__buff.data(), __size);
+	}
+
+	static_any_sized_t& operator=(const static_any_sized_t& another)
+	{
+		if (this != &another)
+		{
+			__size = another.__size;
+			copy_prefix(__buff.data(), another.__buff.data(), __size);
+		}
+		return *this;
+	}
+
+	template <class _ValueT, class = enable_if_value_t<_ValueT>>
+	static_any_sized_t(_ValueT&& t)
+	{
+		copy(std::forward<_ValueT>(t));
+	}
+
+	template <class _ValueT, class = enable_if_value_t<_ValueT>>
+	static_any_sized_t& operator=(_ValueT&& t)
+	{
+		copy(std::forward<_ValueT>(t));
+		return *this;
+	}
+
+	template <class _ValueT>
+	_ValueT& get()
+	{
+		assert(sizeof(_ValueT) == __size);
+		return *reinterpret_cast<_ValueT*>(__buff.data());
+	}
+
+	template <class _ValueT>
+	const _ValueT& get() const
+	{
+		assert(sizeof(_ValueT) == __size);
+		return *reinterpret_cast<const _ValueT*>(__buff.data());
+	}
+
+	void reset() { __size = 0; }
+
+	bool empty() const { return __size == 0; }
+
+	size_type size() const { return __size; }
+
+private:
+	template <class _ValueT>
+	void copy(_ValueT&& t)
+	{
+		using NonConstT = std::remove_cv_t<std::remove_reference_t<_ValueT>>;
+
+		static_assert(detail::static_any::is_trivially_copyable<NonConstT>::value, "_ValueT is not trivially copyable");
+
+		static_assert(capacity() >= sizeof(NonConstT), "_ValueT is too big to be copied to static_any_sized_t");
+		static_assert(alignment() >= alignof(NonConstT), "_ValueT is over-aligned for static_any_sized_t, use a bigger alignment");
+
+		std::memcpy(__buff.data(), &t, sizeof(NonConstT));
+		__size = static_cast<detail::static_any::size_for_t<_N>>(sizeof(NonConstT));
+	}
+
+	// word by word rather than a memcpy call with a runtime size, which costs more than the few bytes usually copied
+	static void copy_prefix(char* to, const char* from, std::size_t size)
+	{
+		constexpr std::size_t word = sizeof(std::uint64_t);
+
+		std::size_t i = 0;
+		for (; i + word <= _N && i < size; i += word)
+			std::memcpy(to + i, from + i, word);
+
+		// only when _N isn't a multiple of a word
+		if (i < size)
+			std::memcpy(to + i, from + i, _N - i);
+	}
+
+	alignas(_A) std::array<char, _N> __buff;
+	detail::static_any::size_for_t<_N> __size{};
+};
+
+namespace detail { namespace static_any {
+
+// Per-thread cache of heap blocks, with one free list per power-of-two size class. Blocks are
+// allocated one by one with operator new, so they can be released to the pool of any thread.
+class pool
+{
+public:
+	static constexpr std::size_t min_block_size = 16;
+	static constexpr std::size_t max_block_size = 4096;
+	static constexpr std::size_t max_cached_blocks = 64;
+
+	static pool& instance()
+	{
+		static thread_local pool p;
+		return p;
+	}
+
+	pool() = default;
+	pool(const pool&) = delete;
+	pool& operator=(const pool&) = delete;
+
+	~pool()
+	{
+		for (free_list& list : __lists)
+		{
+			while (list.head)
+				::operator delete(pop(list));
+		}
+	}
+
+	void* allocate(std::size_t size)
+	{
+		const std::size_t index = size_class(size);
+		if (index == npos)
+			return ::operator new(size);
+
+		free_list& list = __lists[index];
+		if (list.head == nullptr)
+			return ::operator new(min_block_size << index);
+
+		return pop(list);
+	}
+
+	void deallocate(void* block, std::size_t size)
+	{
+		const std::size_t index = size_class(size);
+		if (index == npos || __lists[index].count == max_cached_blocks)
+		{
+			::operator delete(block);
+			return;
+		}
+
+		free_list& list = __lists[index];
+		list.head = new(block) void*(list.head);
+		++list.count;
+	}
+
+	// free blocks kept for the allocations of size bytes
+	std::size_t cached_blocks(std::size_t size) const
+	{
+		const std::size_t index = size_class(size);
+		return index == npos ? 0 : __lists[index].count;
+	}
+
+private:
+	struct free_list
+	{
+		void* head = nullptr;
+		std::size_t count = 0;
+	};
+
+	static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+	static std::size_t size_class(std::size_t size)
+	{
+		if (size > max_block_size)
+			return npos;
+
+		std::size_t index = 0;
+		for (std::size_t block_size = min_block_size; block_size < size; block_size <<= 1)
+			++index;
+		return index;
+	}
+
+	static void* pop(free_list& list)
+	{
+		void* block = list.head;
+		list.head = *reinterpret_cast<void**>(block);
+		--list.count;
+		return block;
 	}
 
-	std::array<char, _N> __buff;
+	std::array<free_list, 9> __lists{}; // 16 to 4096 bytes
+};
+
+struct pool_allocator
+{
+	static constexpr std::size_t max_alignment = alignof(std::max_align_t);
+
+	void* allocate(std::size_t size, std::size_t) { return pool::instance().allocate(size); }
+	void deallocate(void* ptr, std::size_t size, std::size_t) { pool::instance().deallocate(ptr, size); }
+
+	bool operator==(const pool_allocator&) const { return true; }
 };
+
+// Storage of static_any_sbo and static_any_cow: values up to _N bytes are stored in the buffer, bigger ones are
+// spilled by _Derived, which keeps a handle to them in the buffer. _Derived provides spill<_T>(args...),
+// spilled_data(), copy_spilled(), move_spilled(), destroy_spilled(), unique(), make_empty() and max_spill_alignment.
+// common base of every spill_storage, whatever its size
+struct spill_storage_tag {};
+
+template <class _Derived, std::size_t _N, std::size_t _A>
+class spill_storage : private spill_storage_tag
+{
+	static_assert(_A != 0 && (_A & (_A - 1)) == 0, "alignment must be a power of two");
+
+public:
+	using size_type = std::size_t;
+
+	static constexpr size_type capacity() { return _N; }
+	static constexpr size_type alignment() { return _A; }
+
+	void reset() { destroy(); }
+
+	template <class _T>
+	const _T& get() const { return any_cast<_T>(*this); }
+
+	template <class _T>
+	_T& get() { return any_cast<_T>(*this); }
+
+	template <class _T>
+	bool has() const { return holds_type<_T>(__function); }
+
+	const std::type_info& type() const { return empty() ? typeid(void) : *__function->type; }
+
+	std::uint32_t type_id() const { return empty() ? 0 : local_type_id(__function); }
+
+	bool empty() const { return __function == nullptr; }
+
+	size_type size() const { return empty() ? 0 : __function->size; }
+
+	// false when the value has been spilled
+	bool stored_inline() const
+	{
+		return __function != nullptr && __function->size <= _N && __function->alignment <= _A;
+	}
+
+	template <class _T, class... Args>
+	void emplace(Args&&... args)
+	{
+		destroy();
+		construct<_T>(std::forward<Args>(args)...);
+	}
+
+protected:
+	template <class _T>
+	static constexpr bool fits_inline() { return sizeof(_T) <= _N && alignof(_T) <= _A; }
+
+	template <class _T>
+	// nor a static_any_sbo or static_any_cow of another size, which would be stored as a value
+	using enable_if_value_t = std::enable_if_t<!std::is_base_of<spill_storage_tag, std::decay_t<_T>>::value>;
+
+	static constexpr std::size_t buffer_size = _N > sizeof(void*) ? _N : sizeof(void*);
+	static constexpr std::size_t buffer_alignment = _A > alignof(void*) ? _A : alignof(void*);
+
+	spill_storage() = default;
+	spill_storage(const spill_storage&) = delete;
+	spill_storage& operator=(const spill_storage&) = delete;
+	~spill_storage() = default;
+
+	_Derived& derived() { return static_cast<_Derived&>(*this); }
+	const _Derived& derived() const { return static_cast<const _Derived&>(*this); }
+
+	void* data() { return stored_inline() ? __buff.data() : derived().spilled_data(); }
+	const void* data() const { return stored_inline() ? __buff.data() : derived().spilled_data(); }
+
+	template <class _T>
+	const _T* as() const { return reinterpret_cast<const _T*>(data()); }
+
+	template <class _T>
+	_T* as() { return reinterpret_cast<_T*>(data()); }
+
+	template <class _T, class... Args>
+	void construct(Args&&... args)
+	{
+		static_assert(fits_inline<_T>() || alignof(_T) <= _Derived::max_spill_alignment, "_T is over-aligned for the spilled storage");
+		assert(__function == nullptr);
+
+		construct<_T>(std::integral_constant<bool, fits_inline<_T>()>{}, std::forward<Args>(args)...);
+		__function = get_function_for_type<_T>();
+	}
+
+	template <class _T, class... Args>
+	void construct(std::true_type, Args&&... args)
+	{
+		new(__buff.data()) _T(std::forward<Args>(args)...);
+	}
+
+	template <class _T, class... Args>
+	void construct(std::false_type, Args&&... args)
+	{
+		derived().template spill<_T>(std::forward<Args>(args)...);
+	}
+
+	template <class _T>
+	void assign(_T&& t)
+	{
+		using ValueT = std::decay_t<_T>;
+
+		if (assign_in_place(std::forward<_T>(t), std::is_assignable<ValueT&, _T&&>{}))
+			return;
+
+		if (!exceptions || (fits_inline<ValueT>() && std::is_nothrow_constructible<ValueT, _T&&>::value) || empty())
+		{
+			destroy();
+			construct<ValueT>(std::forward<_T>(t));
+			return;
+		}
+
+		_Derived temp = derived().make_empty();
+		temp.template construct<ValueT>(std::forward<_T>(t));
+		derived() = std::move(temp);
+	}
+
+	// only when nobody else sees the stored value
+	template <class _T>
+	bool assign_in_place(_T&& t, std::true_type)
+	{
+		if (__function != get_function_for_type<_T>() || !derived().unique())
+			return false;
+
+		*as<std::decay_t<_T>>() = std::forward<_T>(t);
+		return true;
+	}
+
+	template <class _T>
+	bool assign_in_place(_T&&, std::false_type) { return false; }
+
+	void copy_from(const _Derived& another)
+	{
+		assert(__function == nullptr);
+
+		function_ptr_t function = another.__function;
+		if (function == nullptr)
+			return;
+
+		if (another.stored_inline())
+		{
+			if (bitwise_copyable(function, copy_tag{}))
+				std::memcpy(__buff.data(), another.__buff.data(), _N);
+			else
+				function->copy(__buff.data(), another.__buff.data());
+		}
+		else
+		{
+			derived().copy_spilled(another);
+		}
+
+		__function = function;
+	}
+
+	// a value stored inline is moved and the source keeps the moved-from value, like static_any
+	void move_from(_Derived& another)
+	{
+		assert(__function == nullptr);
+
+		function_ptr_t function = another.__function;
+		if (function == nullptr)
+			return;
+
+		if (another.stored_inline())
+		{
+			if (bitwise_copyable(function, move_tag{}))
+				std::memcpy(__buff.data(), another.__buff.data(), _N);
+			else
+				function->move(__buff.data(), another.__buff.data());
+		}
+		else
+		{
+			derived().move_spilled(another);
+		}
+
+		__function = function;
+	}
+
+	void destroy()
+	{
+		if (__function == nullptr)
+			return;
+
+		if (stored_inline())
+		{
+			if (!__function->trivially_destructible)
+				__function->destroy(__buff.data());
+		}
+		else
+		{
+			derived().destroy_spilled();
+		}
+
+		__function = nullptr;
+	}
+
+	alignas(buffer_alignment) std::array<char, buffer_size> __buff;
+	function_ptr_t __function{};
+
+	friend struct access;
+};
+
+}}
+
+template <std::size_t _N,
+		  std::size_t _A = detail::static_any::default_alignment,
+		  class _Allocator = detail::static_any::pool_allocator>
+class static_any_sbo :
+	public detail::static_any::spill_storage<static_any_sbo<_N, _A, _Allocator>, _N, _A>,
+	private _Allocator
+{
+	using storage_t = detail::static_any::spill_storage<static_any_sbo, _N, _A>;
+
+	template <class _T>
+	using enable_if_value_t = typename storage_t::template enable_if_value_t<_T>;
+
+public:
+	using allocator_type = _Allocator;
+
+	static_any_sbo() = default;
+
+	static_any_sbo(std::allocator_arg_t, const allocator_type& allocator) :
+		_Allocator(allocator)
+	{}
+
+	~static_any_sbo() { this->destroy(); }
+
+	template <class _T, class = enable_if_value_t<_T>>
+	static_any_sbo(_T&& t)
+	{
+		this->template construct<std::decay_t<_T>>(std::forward<_T>(t));
+	}
+
+	template <class _T, class = enable_if_value_t<_T>>
+	static_any_sbo(std::allocator_arg_t, const allocator_type& allocator, _T&& t) :
+		_Allocator(allocator)
+	{
+		this->template construct<std::decay_t<_T>>(std::forward<_T>(t));
+	}
+
+	static_any_sbo(const static_any_sbo& another) :
+		storage_t(),
+		_Allocator(another)
+	{
+		this->copy_from(another);
+	}
+
+	static_any_sbo(static_any_sbo&& another) :
+		storage_t(),
+		_Allocator(another)
+	{
+		this->move_from(another);
+	}
+
+	template <class _T, class = enable_if_value_t<_T>>
+	static_any_sbo& operator=(_T&& t)
+	{
+		this->assign(std::forward<_T>(t));
+		return *this;
+	}
+
+	static_any_sbo& operator=(const static_any_sbo& another)
+	{
+		if (this == &another)
+			return *this;
+
+		if (another.empty())
+		{
+			this->reset();
+			return *this;
+		}
+
+		if (this->__function == another.__function && this->__function->copy_assign)
+		{
+			this->__function->copy_assign(this->data(), another.data());
+			return *this;
+		}
+
+		if (!detail::static_any::exceptions)
+		{
+			this->destroy();
+			this->copy_from(another);
+			return *this;
+		}
+
+		static_any_sbo temp = make_empty();
+		temp.copy_from(another);
+		return *this = std::move(temp);
+	}
+
+	// strong guarantee when the stored value is on the heap or is nothrow movable
+	static_any_sbo& operator=(static_any_sbo&& another)
+	{
+		if (this == &another)
+			return *this;
+
+		this->destroy();
+		this->move_from(another);
+		return *this;
+	}
+
+	const allocator_type& get_allocator() const { return *this; }
+
+private:
+	friend storage_t;
+
+	static constexpr std::size_t max_spill_alignment = _Allocator::max_alignment;
+
+	_Allocator& allocator() { return *this; }
+
+	void*& heap_ptr() { return *reinterpret_cast<void**>(this->__buff.data()); }
+	void* heap_ptr() const { return *reinterpret_cast<void* const*>(this->__buff.data()); }
+
+	void* spilled_data() const { return heap_ptr(); }
+
+	bool unique() const { return true; }
+
+	static_any_sbo make_empty() const { return static_any_sbo(std::allocator_arg, get_allocator()); }
+
+	template <class _T, class... Args>
+	void spill(Args&&... args)
+	{
+		void* ptr = allocator().allocate(sizeof(_T), alignof(_T));
+		STATIC_ANY_TRY {
+			new(ptr) _T(std::forward<Args>(args)...);
+		}
+		STATIC_ANY_CATCH_ALL {
+			allocator().deallocate(ptr, sizeof(_T), alignof(_T));
+			STATIC_ANY_RETHROW;
+		}
+		new(this->__buff.data()) void*(ptr);
+	}
+
+	void copy_spilled(const static_any_sbo& another)
+	{
+		detail::static_any::function_ptr_t function = another.__function;
+
+		void* ptr = allocator().allocate(function->size, function->alignment);
+		STATIC_ANY_TRY {
+			function->copy(ptr, another.heap_ptr());
+		}
+		STATIC_ANY_CATCH_ALL {
+			allocator().deallocate(ptr, function->size, function->alignment);
+			STATIC_ANY_RETHROW;
+		}
+		new(this->__buff.data()) void*(ptr);
+	}
+
+	// a spilled value is stolen and the source is left empty
+	void move_spilled(static_any_sbo& another)
+	{
+		detail::static_any::function_ptr_t function = another.__function;
+
+		if (allocator() == another.allocator())
+		{
+			new(this->__buff.data()) void*(another.heap_ptr());
+			another.__function = nullptr;
+			return;
+		}
+
+		void* ptr = allocator().allocate(function->size, function->alignment);
+		STATIC_ANY_TRY {
+			function->move(ptr, another.heap_ptr());
+		}
+		STATIC_ANY_CATCH_ALL {
+			allocator().deallocate(ptr, function->size, function->alignment);
+			STATIC_ANY_RETHROW;
+		}
+		new(this->__buff.data()) void*(ptr);
+		another.destroy();
+	}
+
+	void destroy_spilled()
+	{
+		void* ptr = heap_ptr();
+		this->__function->destroy(ptr);
+		allocator().deallocate(ptr, this->__function->size, this->__function->alignment);
+	}
+};
+
+template <class _ValueT,
+		  class _SD,
+		  std::size_t _S,
+		  std::size_t _SA>
+inline _ValueT* any_cast(detail::static_any::spill_storage<_SD, _S, _SA>* a)
+{
+	if (!a->template has<_ValueT>())
+		return nullptr;
+
+	return detail::static_any::access::as<_ValueT>(*a);
+}
+
+template <class _ValueT,
+		  class _SD,
+		  std::size_t _S,
+		  std::size_t _SA>
+inline const _ValueT* any_cast(const detail::static_any::spill_storage<_SD, _S, _SA>* a)
+{
+	if (!a->template has<_ValueT>())
+		return nullptr;
+
+	return detail::static_any::access::as<const _ValueT>(*a);
+}
+
+template <class _ValueT,
+		  class _SD,
+		  std::size_t _S,
+		  std::size_t _SA>
+inline _ValueT& any_cast(detail::static_any::spill_storage<_SD, _S, _SA>& a)
+{
+	if (!a.template has<_ValueT>())
+		detail::static_any::raise(bad_any_cast(a.type(), typeid(_ValueT)));
+
+	return *any_cast<_ValueT>(&a);
+}
+
+template <class _ValueT,
+		  class _SD,
+		  std::size_t _S,
+		  std::size_t _SA>
+inline const _ValueT& any_cast(const detail::static_any::spill_storage<_SD, _S, _SA>& a)
+{
+	if (!a.template has<_ValueT>())
+		detail::static_any::raise(bad_any_cast(a.type(), typeid(_ValueT)));
+
+	return *any_cast<_ValueT>(&a);
+}
+
+namespace detail { namespace static_any {
+
+template <class _Resource>
+struct default_resource
+{
+	static _Resource* get() { return nullptr; }
+};
+
+#ifdef STATIC_ANY_HAS_MEMORY_RESOURCE
+template <>
+struct default_resource<std::pmr::memory_resource>
+{
+	static std::pmr::memory_resource* get() { return std::pmr::get_default_resource(); }
+};
+#endif
+
+// Allocator of static_any_sbo forwarding to a memory resource: anything with the allocate(bytes, alignment)
+// and deallocate(ptr, bytes, alignment) members of std::pmr::memory_resource
+template <class _Resource>
+class resource_allocator
+{
+public:
+	static constexpr std::size_t max_alignment = std::numeric_limits<std::size_t>::max();
+
+	resource_allocator() :
+		__resource(default_resource<_Resource>::get())
+	{}
+
+	resource_allocator(_Resource* resource) :
+		__resource(resource)
+	{}
+
+	void* allocate(std::size_t size, std::size_t alignment)
+	{
+		if (__resource == nullptr)
+			detail::static_any::raise(std::bad_alloc());
+		return __resource->allocate(size, alignment);
+	}
+
+	void deallocate(void* ptr, std::size_t size, std::size_t alignment)
+	{
+		__resource->deallocate(ptr, size, alignment);
+	}
+
+	_Resource* resource() const { return __resource; }
+
+	bool operator==(const resource_allocator& other) const { return __resource == other.__resource; }
+
+private:
+	_Resource* __resource;
+};
+
+}}
+
+// Monotonic arena: allocations bump a pointer in chunks obtained from operator new, deallocate() is a
+// no-op and the memory is released all at once by release() or the destructor
+class static_any_arena
+{
+public:
+	explicit static_any_arena(std::size_t chunk_size = 4096) :
+		__chunk_size(chunk_size)
+	{}
+
+	static_any_arena(const static_any_arena&) = delete;
+	static_any_arena& operator=(const static_any_arena&) = delete;
+
+	~static_any_arena() { release(); }
+
+	void* allocate(std::size_t size, std::size_t alignment)
+	{
+		void* ptr = __current;
+		std::size_t space = static_cast<std::size_t>(__end - __current);
+
+		if (std::align(alignment, size, ptr, space) == nullptr)
+		{
+			add_chunk(size + alignment);
+			ptr = __current;
+			space = static_cast<std::size_t>(__end - __current);
+			std::align(alignment, size, ptr, space);
+		}
+
+		__current = reinterpret_cast<char*>(ptr) + size;
+		return ptr;
+	}
+
+	void deallocate(void*, std::size_t, std::size_t) {}
+
+	void release()
+	{
+		while (__chunks)
+		{
+			chunk* next = __chunks->next;
+			::operator delete(__chunks);
+			__chunks = next;
+		}
+
+		__current = nullptr;
+		__end = nullptr;
+	}
+
+private:
+	struct chunk
+	{
+		chunk* next;
+	};
+
+	void add_chunk(std::size_t min_size)
+	{
+		const std::size_t size = sizeof(chunk) + (min_size > __chunk_size ? min_size : __chunk_size);
+
+		char* memory = reinterpret_cast<char*>(::operator new(size));
+		__chunks = new(memory) chunk{__chunks};
+		__current = memory + sizeof(chunk);
+		__end = memory + size;
+	}
+
+	const std::size_t __chunk_size;
+	chunk* __chunks = nullptr;
+	char* __current = nullptr;
+	char* __end = nullptr;
+};
+
+// static_any_sbo spilling to a memory resource given at construction: with a monotonic resource, releasing
+// a spilled value only runs its destructor. Copies share the resource of the original.
+#ifdef STATIC_ANY_HAS_MEMORY_RESOURCE
+template <std::size_t _N,
+		  class _Resource = std::pmr::memory_resource,
+		  std::size_t _A = detail::static_any::default_alignment>
+#else
+template <std::size_t _N,
+		  class _Resource,
+		  std::size_t _A = detail::static_any::default_alignment>
+#endif
+using static_any_pmr = static_any_sbo<_N, _A, detail::static_any::resource_allocator<_Resource>>;
+
+// Copy-on-write container: values up to N bytes are stored inline like static_any, bigger ones live in a
+// reference counted block shared by the copies. The block is copied by the first mutable access through a
+// copy sharing it, so copies keep value semantics. As the reference returned by that access can still be written
+// through, the block is no longer shared afterwards: the later copies copy the value, like COW strings.
+template <std::size_t _N, std::size_t _A = detail::static_any::default_alignment>
+class static_any_cow :
+	public detail::static_any::spill_storage<static_any_cow<_N, _A>, _N, _A>
+{
+	using storage_t = detail::static_any::spill_storage<static_any_cow, _N, _A>;
+
+	template <class _T>
+	using enable_if_value_t = typename storage_t::template enable_if_value_t<_T>;
+
+public:
+	using size_type = typename storage_t::size_type;
+
+	static_any_cow() = default;
+
+	~static_any_cow() { this->destroy(); }
+
+	template <class _T, class = enable_if_value_t<_T>>
+	static_any_cow(_T&& t)
+	{
+		this->template construct<std::decay_t<_T>>(std::forward<_T>(t));
+	}
+
+	static_any_cow(const static_any_cow& another) :
+		storage_t()
+	{
+		this->copy_from(another);
+	}
+
+	static_any_cow(static_any_cow&& another) :
+		storage_t()
+	{
+		this->move_from(another);
+	}
+
+	template <class _T, class = enable_if_value_t<_T>>
+	static_any_cow& operator=(_T&& t)
+	{
+		this->assign(std::forward<_T>(t));
+		return *this;
+	}
+
+	static_any_cow& operator=(const static_any_cow& another)
+	{
+		if (this == &another)
+			return *this;
+
+		if (another.empty())
+		{
+			this->reset();
+			return *this;
+		}
+
+		static_any_cow temp(another);
+		return *this = std::move(temp);
+	}
+
+	static_any_cow& operator=(static_any_cow&& another)
+	{
+		if (this == &another)
+			return *this;
+
+		this->destroy();
+		this->move_from(another);
+		return *this;
+	}
+
+	// number of containers sharing the value: 0 when empty, 1 when inline or not shared
+	size_type use_count() const
+	{
+		if (this->empty())
+			return 0;
+		return this->stored_inline() ? 1 : block()->refcount.load(std::memory_order_acquire);
+	}
+
+private:
+	friend storage_t;
+
+	using function_ptr_t = detail::static_any::function_ptr_t;
+
+	struct shared_block
+	{
+		shared_block() : refcount(1) {}
+
+		std::atomic<std::size_t> refcount;
+		// only written while the block isn't shared
+		bool shareable = true;
+	};
+
+	static constexpr std::size_t max_spill_alignment = alignof(std::max_align_t);
+
+	static constexpr std::size_t value_offset =
+		(sizeof(shared_block) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+	shared_block* block() const { return *reinterpret_cast<shared_block* const*>(this->__buff.data()); }
+
+	static void* value_of(shared_block* block) { return reinterpret_cast<char*>(block) + value_offset; }
+
+	static shared_block* allocate_block(function_ptr_t function)
+	{
+		void* memory = detail::static_any::pool::instance().allocate(value_offset + function->size);
+		return new(memory) shared_block;
+	}
+
+	static void deallocate_block(shared_block* block, function_ptr_t function)
+	{
+		block->~shared_block();
+		detail::static_any::pool::instance().deallocate(block, value_offset + function->size);
+	}
+
+	static void release(shared_block* block, function_ptr_t function)
+	{
+		if (block->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			function->destroy(value_of(block));
+			deallocate_block(block, function);
+		}
+	}
+
+	const void* spilled_data() const { return value_of(block()); }
+
+	// a mutable access makes the value private to this container first, and keeps it private
+	void* spilled_data()
+	{
+		unshare();
+		block()->shareable = false;
+		return value_of(block());
+	}
+
+	bool unique() const { return use_count() == 1; }
+
+	static static_any_cow make_empty() { return static_any_cow(); }
+
+	void unshare()
+	{
+		shared_block* shared = block();
+		if (shared->refcount.load(std::memory_order_acquire) == 1)
+			return;
+
+		shared_block* copy = allocate_block(this->__function);
+		STATIC_ANY_TRY {
+			this->__function->copy(value_of(copy), value_of(shared));
+		}
+		STATIC_ANY_CATCH_ALL {
+			deallocate_block(copy, this->__function);
+			STATIC_ANY_RETHROW;
+		}
+
+		release(shared, this->__function);
+		new(this->__buff.data()) shared_block*(copy);
+	}
+
+	template <class _T, class... Args>
+	void spill(Args&&... args)
+	{
+		function_ptr_t function = detail::static_any::get_function_for_type<_T>();
+
+		shared_block* shared = allocate_block(function);
+		STATIC_ANY_TRY {
+			new(value_of(shared)) _T(std::forward<Args>(args)...);
+		}
+		STATIC_ANY_CATCH_ALL {
+			deallocate_block(shared, function);
+			STATIC_ANY_RETHROW;
+		}
+		new(this->__buff.data()) shared_block*(shared);
+	}
+
+	void copy_spilled(const static_any_cow& another)
+	{
+		shared_block* shared = another.block();
+		if (shared->shareable)
+		{
+			shared->refcount.fetch_add(1, std::memory_order_relaxed);
+			new(this->__buff.data()) shared_block*(shared);
+			return;
+		}
+
+		function_ptr_t function = another.__function;
+
+		shared_block* copy = allocate_block(function);
+		STATIC_ANY_TRY {
+			function->copy(value_of(copy), value_of(shared));
+		}
+		STATIC_ANY_CATCH_ALL {
+			deallocate_block(copy, function);
+			STATIC_ANY_RETHROW;
+		}
+		new(this->__buff.data()) shared_block*(copy);
+	}
+
+	// a shared value is stolen and the source is left empty
+	void move_spilled(static_any_cow& another)
+	{
+		new(this->__buff.data()) shared_block*(another.block());
+		another.__function = nullptr;
+	}
+
+	void destroy_spilled() { release(block(), this->__function); }
+};
+
+namespace detail { namespace static_any {
+
+template <bool... _Values>
+struct all_of : std::is_same<std::integer_sequence<bool, true, _Values...>, std::integer_sequence<bool, _Values..., true>> {};
+
+// 1-based position of _T in _Ts, 0 if not found
+template <class _T, class... _Ts>
+struct index_of : std::integral_constant<std::size_t, 0> {};
+
+template <class _T, class... _Ts>
+struct index_of<_T, _T, _Ts...> : std::integral_constant<std::size_t, 1> {};
+
+template <class _T, class _U, class... _Ts>
+struct index_of<_T, _U, _Ts...> :
+	std::integral_constant<std::size_t, index_of<_T, _Ts...>::value == 0 ? 0 : index_of<_T, _Ts...>::value + 1> {};
+
+// calls f(static_cast<T*>(nullptr)) for the type T at the 1-based position index of _Ts, through a
+// switch over 8 positions at a time so that it compiles to a jump table
+template <std::size_t _First, class... _Ts>
+struct type_switch
+{
+	template <class _F>
+	static void apply(std::size_t index, _F&& f)
+	{
+		switch (index - _First)
+		{
+		case 0: call<0>(f); break;
+		case 1: call<1>(f); break;
+		case 2: call<2>(f); break;
+		case 3: call<3>(f); break;
+		case 4: call<4>(f); break;
+		case 5: call<5>(f); break;
+		case 6: call<6>(f); break;
+		case 7: call<7>(f); break;
+		default: next(index, f, std::integral_constant<bool, (_First + 8 <= sizeof...(_Ts))>{}); break;
+		}
+	}
+
+private:
+	template <std::size_t _K, class _F>
+	static void call(_F& f)
+	{
+		call<_K>(f, std::integral_constant<bool, (_First + _K <= sizeof...(_Ts))>{});
+	}
+
+	template <std::size_t _K, class _F>
+	static void call(_F& f, std::true_type)
+	{
+		f(static_cast<std::tuple_element_t<_First + _K - 1, std::tuple<_Ts...>>*>(nullptr));
+	}
+
+	template <std::size_t _K, class _F>
+	static void call(_F&, std::false_type) { assert(false); }
+
+	template <class _F>
+	static void next(std::size_t index, _F& f, std::true_type)
+	{
+		type_switch<_First + 8, _Ts...>::apply(index, f);
+	}
+
+	template <class _F>
+	static void next(std::size_t, _F&, std::false_type) { assert(false); }
+};
+
+template <bool _Trivial, class... _Ts>
+class any_of_storage;
+
+// all the types are trivially copyable: so is the storage
+template <class... _Ts>
+class any_of_storage<true, _Ts...>
+{
+protected:
+	void destroy() { __index = 0; }
+
+	alignas(std::max({alignof(_Ts)...})) std::array<char, std::max({sizeof(_Ts)...})> __buff;
+	std::uint8_t __index = 0;
+};
+
+template <class... _Ts>
+class any_of_storage<false, _Ts...>
+{
+public:
+	any_of_storage() = default;
+
+	any_of_storage(const any_of_storage& another)
+	{
+		copy_from(another);
+	}
+
+	any_of_storage(any_of_storage&& another)
+	{
+		move_from(another);
+	}
+
+	any_of_storage& operator=(const any_of_storage& another)
+	{
+		if (this != &another)
+		{
+			destroy();
+			copy_from(another);
+		}
+		return *this;
+	}
+
+	any_of_storage& operator=(any_of_storage&& another)
+	{
+		if (this != &another)
+		{
+			destroy();
+			move_from(another);
+		}
+		return *this;
+	}
+
+	~any_of_storage() { destroy(); }
+
+protected:
+	void destroy()
+	{
+		if (__index == 0)
+			return;
+
+		type_switch<1, _Ts...>::apply(__index, [this](auto* tag)
+		{
+			using T = std::remove_pointer_t<decltype(tag)>;
+			reinterpret_cast<T*>(__buff.data())->~T();
+		});
+		__index = 0;
+	}
+
+	alignas(std::max({alignof(_Ts)...})) std::array<char, std::max({sizeof(_Ts)...})> __buff;
+	std::uint8_t __index = 0;
+
+private:
+	void copy_from(const any_of_storage& another)
+	{
+		if (another.__index == 0)
+			return;
+
+		type_switch<1, _Ts...>::apply(another.__index, [this, &another](auto* tag)
+		{
+			using T = std::remove_pointer_t<decltype(tag)>;
+			new(__buff.data()) T(*reinterpret_cast<const T*>(another.__buff.data()));
+		});
+		__index = another.__index;
+	}
+
+	void move_from(any_of_storage& another)
+	{
+		if (another.__index == 0)
+			return;
+
+		type_switch<1, _Ts...>::apply(another.__index, [this, &another](auto* tag)
+		{
+			using T = std::remove_pointer_t<decltype(tag)>;
+			new(__buff.data()) T(std::move(*reinterpret_cast<T*>(another.__buff.data())));
+		});
+		__index = another.__index;
+	}
+};
+
+}}
+
+// Container for a closed set of types: the buffer is sized and aligned for the biggest of _Ts, and the
+// stored type is identified by a 1 byte index instead of a function table pointer. Copies, moves and
+// destruction dispatch on the index at compile time. Like static_any_t, it is trivially copyable when
+// all the types are.
+//
+// Assignment offers the basic exception guarantee: when the construction of a new value throws,
+// the container is left empty, like emplace().
+template <class... _Ts>
+class static_any_of :
+	private detail::static_any::any_of_storage<detail::static_any::all_of<detail::static_any::is_trivially_copyable<_Ts>::value...>::value, _Ts...>
+{
+	static_assert(sizeof...(_Ts) > 0 && sizeof...(_Ts) < 256, "static_any_of needs between 1 and 255 types");
+
+	using storage_t = detail::static_any::any_of_storage<detail::static_any::all_of<detail::static_any::is_trivially_copyable<_Ts>::value...>::value, _Ts...>;
+
+	template <class _T>
+	using index_of_t = detail::static_any::index_of<std::decay_t<_T>, _Ts...>;
+
+	template <class _T>
+	using enable_if_value_t = std::enable_if_t<!std::is_same<std::decay_t<_T>, static_any_of>::value>;
+
+public:
+	using size_type = std::size_t;
+
+	static constexpr size_type npos = static_cast<size_type>(-1);
+
+	static constexpr size_type capacity() { return std::max({sizeof(_Ts)...}); }
+	static constexpr size_type alignment() { return std::max({alignof(_Ts)...}); }
+
+	static_any_of() = default;
+
+	template <class _T, class = enable_if_value_t<_T>>
+	static_any_of(_T&& t)
+	{
+		construct<std::decay_t<_T>>(std::forward<_T>(t));
+	}
+
+	template <class _T, class = enable_if_value_t<_T>>
+	static_any_of& operator=(_T&& t)
+	{
+		using ValueT = std::decay_t<_T>;
+
+		if (!assign_in_place(std::forward<_T>(t), std::is_assignable<ValueT&, _T&&>{}))
+		{
+			this->destroy();
+			construct<ValueT>(std::forward<_T>(t));
+		}
+		return *this;
+	}
+
+	void reset() { this->destroy(); }
+
+	template <class _T>
+	const _T& get() const { return any_cast<_T>(*this); }
+
+	template <class _T>
+	_T& get() { return any_cast<_T>(*this); }
+
+	template <class _T>
+	bool has() const
+	{
+		return index_of_t<_T>::value != 0 && this->__index == index_of_t<_T>::value;
+	}
+
+	// position of the stored type in _Ts, npos when empty
+	size_type index() const { return empty() ? npos : static_cast<size_type>(this->__index - 1); }
+
+	const std::type_info& type() const
+	{
+		const std::type_info* info = &typeid(void);
+		if (!empty())
+		{
+			detail::static_any::type_switch<1, _Ts...>::apply(this->__index, [&info](auto* tag)
+			{
+				info = &typeid(std::remove_pointer_t<decltype(tag)>);
+			});
+		}
+		return *info;
+	}
+
+	std::uint32_t type_id() const
+	{
+		std::uint32_t id = 0;
+		if (!empty())
+		{
+			detail::static_any::type_switch<1, _Ts...>::apply(this->__index, [&id](auto* tag)
+			{
+				id = type_id_of<std::remove_pointer_t<decltype(tag)>>();
+			});
+		}
+		return id;
+	}
+
+	bool empty() const { return this->__index == 0; }
+
+	size_type size() const
+	{
+		size_type size = 0;
+		if (!empty())
+		{
+			detail::static_any::type_switch<1, _Ts...>::apply(this->__index, [&size](auto* tag)
+			{
+				size = sizeof(std::remove_pointer_t<decltype(tag)>);
+			});
+		}
+		return size;
+	}
+
+	template <class _T, class... Args>
+	void emplace(Args&&... args)
+	{
+		this->destroy();
+		construct<_T>(std::forward<Args>(args)...);
+	}
+
+private:
+	template <class _T, class... Args>
+	void construct(Args&&... args)
+	{
+		static_assert(index_of_t<_T>::value != 0, "_T is not one of the types of static_any_of");
+		assert(empty());
+
+		new(this->__buff.data()) _T(std::forward<Args>(args)...);
+		this->__index = static_cast<std::uint8_t>(index_of_t<_T>::value);
+	}
+
+	template <class _T>
+	bool assign_in_place(_T&& t, std::true_type)
+	{
+		if (!has<_T>())
+			return false;
+
+		*as<std::decay_t<_T>>() = std::forward<_T>(t);
+		return true;
+	}
+
+	template <class _T>
+	bool assign_in_place(_T&&, std::false_type) { return false; }
+
+	template <class _T>
+	const _T* as() const { return reinterpret_cast<const _T*>(this->__buff.data()); }
+
+	template <class _T>
+	_T* as() { return reinterpret_cast<_T*>(this->__buff.data()); }
+
+	template <class _ValueT, class... _Us>
+	friend _ValueT* any_cast(static_any_of<_Us...>*);
+};
+
+template <class... _Ts>
+constexpr typename static_any_of<_Ts...>::size_type static_any_of<_Ts...>::npos;
+
+template <class _ValueT,
+		  class... _Ts>
+inline _ValueT* any_cast(static_any_of<_Ts...>* a)
+{
+	if (!a->template has<std::remove_cv_t<_ValueT>>())
+		return nullptr;
+
+	return a->template as<_ValueT>();
+}
+
+template <class _ValueT,
+		  class... _Ts>
+inline const _ValueT* any_cast(const static_any_of<_Ts...>* a)
+{
+	return any_cast<const _ValueT>(const_cast<static_any_of<_Ts...>*>(a));
+}
+
+template <class _ValueT,
+		  class... _Ts>
+inline _ValueT& any_cast(static_any_of<_Ts...>& a)
+{
+	_ValueT* value = any_cast<_ValueT>(&a);
+	if (value == nullptr)
+		detail::static_any::raise(bad_any_cast(a.type(), typeid(_ValueT)));
+
+	return *value;
+}
+
+template <class _ValueT,
+		  class... _Ts>
+inline const _ValueT& any_cast(const static_any_of<_Ts...>& a)
+{
+	return any_cast<const _ValueT>(const_cast<static_any_of<_Ts...>&>(a));
+}
+
+namespace detail { namespace static_any {
+
+// Encoding of static_any_compact in 64 bits. A word is a double, unless its 12 high bits are all set: then bits 48 to 51
+// are a tag and the 48 low bits its payload. Only -inf is such a double, and NaNs are stored as the positive quiet NaN.
+struct compact
+{
+	static constexpr std::uint64_t boxed = 0xFFF0000000000000ull;
+	static constexpr std::uint64_t payload_mask = 0x0000FFFFFFFFFFFFull;
+	static constexpr std::uint64_t quiet_nan = 0x7FF8000000000000ull;
+
+	enum tag : unsigned
+	{
+		double_tag = 0,     // -inf
+		empty_tag = 1,
+		small_tag = 2,      // a 16-bit type id, then a value of at most 4 bytes in the 32 low bits
+		cell_tag = 3,       // the address of a block from the pool, holding the function table then the value
+		first_wide_tag = 4, // 4 to 15: a value of an 8-byte integer or pointer type fitting in 48 bits, sign-extended
+		wide_tags = 12
+	};
+
+	// offset of the value in a cell
+	static constexpr std::size_t value_offset = alignof(std::max_align_t) > sizeof(function_ptr_t) ? alignof(std::max_align_t) : sizeof(function_ptr_t);
+
+	static constexpr std::uint64_t box(unsigned tag, std::uint64_t payload)
+	{
+		return boxed | (static_cast<std::uint64_t>(tag) << 48) | (payload & payload_mask);
+	}
+
+	static unsigned tag_of(std::uint64_t bits)
+	{
+		return (bits & boxed) == boxed ? static_cast<unsigned>(bits >> 48) & 0xF : double_tag;
+	}
+
+	static std::uint64_t payload_of(std::uint64_t bits) { return bits & payload_mask; }
+
+	static bool fits_in_payload(std::uint64_t value)
+	{
+		const std::uint64_t high = value >> 47;
+		return high == 0 || high == 0x1FFFF;
+	}
+
+	static std::uint64_t sign_extend(std::uint64_t payload)
+	{
+		return (payload >> 47) != 0 ? payload | ~payload_mask : payload;
+	}
+};
+
+// The types stored inline by static_any_compact, identified by their 1-based position in these lists rather than by
+// a type id: the ids of the registries differ between modules, and a boxed word has no room for a table
+template <class... _Ts>
+struct compact_types
+{
+	static constexpr std::size_t size = sizeof...(_Ts);
+
+	template <class _T>
+	static constexpr unsigned position() { return static_cast<unsigned>(index_of<_T, _Ts...>::value); }
+
+	static function_ptr_t table(unsigned position)
+	{
+		static const function_ptr_t tables[] = { get_function_for_type<_Ts>()... };
+		return tables[position - 1];
+	}
+};
+
+// small ones are stored with their position, each wide one has its tag
+using compact_small_types = compact_types<bool, char, signed char, unsigned char, wchar_t, char16_t, char32_t,
+										  short, unsigned short, int, unsigned, long, unsigned long, float>;
+using compact_wide_types = compact_types<long, unsigned long, long long, unsigned long long,
+										 void*, const void*, char*, const char*>;
+
+static_assert(compact_wide_types::size <= compact::wide_tags, "not enough tags for the wide types of static_any_compact");
+
+struct compact_double_kind {};
+struct compact_small_kind {};
+struct compact_wide_kind {};
+struct compact_cell_kind {};
+
+template <class _T>
+struct compact_traits
+{
+	using kind = std::conditional_t<std::is_same<_T, double>::value, compact_double_kind,
+				 std::conditional_t<compact_small_types::position<_T>() != 0 && sizeof(_T) <= sizeof(std::uint32_t), compact_small_kind,
+				 std::conditional_t<compact_wide_types::position<_T>() != 0 && sizeof(_T) == sizeof(std::uint64_t), compact_wide_kind,
+				 compact_cell_kind>>>;
+
+	// values which can be stored inline have no address, they are read by value
+	static constexpr bool by_value = !std::is_same<kind, compact_cell_kind>::value;
+
+	static constexpr std::uint32_t small_type_id() { return compact_small_types::position<_T>(); }
+
+	static constexpr unsigned wide_tag() { return compact::first_wide_tag + compact_wide_types::position<_T>() - 1; }
+};
+
+}}
+
+// An 8-byte container for scalar-heavy data: doubles are NaN-boxed, the other fundamental types of at most 4 bytes
+// (int, float, bool, char, ...) and 8-byte integers and untyped or char pointers fitting in 48 bits are tagged inline,
+// and the other values go to a cell allocated from the pool. As inline values have no address, get() and any_cast()
+// return the types which can be stored inline by value, and references to the others. The inline types are identified
+// by fixed positions, so that values can be passed between modules.
+class static_any_compact
+{
+	using compact = detail::static_any::compact;
+	using function_ptr_t = detail::static_any::function_ptr_t;
+
+	template <class _T>
+	using traits = detail::static_any::compact_traits<std::remove_cv_t<_T>>;
+
+	template <class _T>
+	using enable_if_value_t = std::enable_if_t<!std::is_same<std::decay_t<_T>, static_any_compact>::value>;
+
+	static_assert(std::numeric_limits<double>::is_iec559 && sizeof(double) == sizeof(std::uint64_t), "static_any_compact needs 64-bit IEEE 754 doubles");
+
+public:
+	using size_type = std::size_t;
+
+	template <class _T>
+	static constexpr bool by_value_v = traits<_T>::by_value;
+
+	static_any_compact() = default;
+
+	~static_any_compact() { destroy(); }
+
+	template <class _T, class = enable_if_value_t<_T>>
+	static_any_compact(_T&& t) :
+		__bits(encode<std::decay_t<_T>>(typename traits<std::decay_t<_T>>::kind{}, std::forward<_T>(t)))
+	{}
+
+	static_any_compact(const static_any_compact& another) :
+		__bits(another.copy_bits())
+	{}
+
+	static_any_compact(static_any_compact&& another) noexcept :
+		__bits(another.__bits)
+	{
+		another.__bits = empty_bits;
+	}
+
+	template <class _T, class = enable_if_value_t<_T>>
+	static_any_compact& operator=(_T&& t)
+	{
+		const std::uint64_t bits = encode<std::decay_t<_T>>(typename traits<std::decay_t<_T>>::kind{}, std::forward<_T>(t));
+		destroy();
+		__bits = bits;
+		return *this;
+	}
+
+	static_any_compact& operator=(const static_any_compact& another)
+	{
+		if (this != &another)
+		{
+			const std::uint64_t bits = another.copy_bits();
+			destroy();
+			__bits = bits;
+		}
+		return *this;
+	}
+
+	static_any_compact& operator=(static_any_compact&& another) noexcept
+	{
+		if (this != &another)
+		{
+			destroy();
+			__bits = another.__bits;
+			another.__bits = empty_bits;
+		}
+		return *this;
+	}
+
+	void reset() { destroy(); }
+
+	// doubles, small values, 8-byte integers and pointers
+	template <class _T>
+	std::enable_if_t<by_value_v<_T>, std::remove_cv_t<_T>> get() const
+	{
+		check<_T>();
+		if (compact::tag_of(__bits) == compact::cell_tag)
+			return *static_cast<const std::remove_cv_t<_T>*>(cell_value());
+
+		return load<std::remove_cv_t<_T>>(typename traits<_T>::kind{});
+	}
+
+	template <class _T>
+	std::enable_if_t<!by_value_v<_T>, const _T&> get() const
+	{
+		check<_T>();
+		return *static_cast<const _T*>(cell_value());
+	}
+
+	template <class _T>
+	std::enable_if_t<!by_value_v<_T>, _T&> get()
+	{
+		check<_T>();
+		return *static_cast<_T*>(cell_value());
+	}
+
+	template <class _T>
+	std::enable_if_t<!by_value_v<_T>, const _T*> get_if() const noexcept
+	{
+		return has<_T>() ? static_cast<const _T*>(cell_value()) : nullptr;
+	}
+
+	template <class _T>
+	std::enable_if_t<!by_value_v<_T>, _T*> get_if() noexcept
+	{
+		return has<_T>() ? static_cast<_T*>(cell_value()) : nullptr;
+	}
+
+	template <class _T>
+	bool has() const
+	{
+		using NonConstT = std::remove_cv_t<_T>;
+		return has<NonConstT>(typename traits<NonConstT>::kind{}, compact::tag_of(__bits));
+	}
+
+	const std::type_info& type() const
+	{
+		function_ptr_t function = query_function();
+		return function ? *function->type : typeid(void);
+	}
+
+	std::uint32_t type_id() const
+	{
+		function_ptr_t function = query_function();
+		return function ? detail::static_any::local_type_id(function) : 0;
+	}
+
+	bool empty() const { return __bits == empty_bits; }
+
+	size_type size() const
+	{
+		function_ptr_t function = query_function();
+		return function ? function->size : 0;
+	}
+
+	bool stored_inline() const { return !empty() && compact::tag_of(__bits) != compact::cell_tag; }
+
+	template <class _T, class... Args>
+	void emplace(Args&&... args)
+	{
+		const std::uint64_t bits = emplace_bits<_T>(std::integral_constant<bool, by_value_v<_T>>{}, std::forward<Args>(args)...);
+		destroy();
+		__bits = bits;
+	}
+
+private:
+	static constexpr std::uint64_t empty_bits = compact::box(compact::empty_tag, 0);
+
+	template <class _T>
+	void check() const
+	{
+		if (!has<_T>())
+			detail::static_any::raise(bad_any_cast(type(), typeid(_T)));
+	}
+
+	template <class _T>
+	bool has(detail::static_any::compact_double_kind, unsigned tag) const { return tag == compact::double_tag; }
+
+	template <class _T>
+	bool has(detail::static_any::compact_small_kind, unsigned tag) const
+	{
+		if (tag == compact::small_tag)
+			return small_type_id() == traits<_T>::small_type_id();
+		return has<_T>(detail::static_any::compact_cell_kind{}, tag);
+	}
+
+	template <class _T>
+	bool has(detail::static_any::compact_wide_kind, unsigned tag) const
+	{
+		if (tag >= compact::first_wide_tag)
+			return tag == traits<_T>::wide_tag();
+		return has<_T>(detail::static_any::compact_cell_kind{}, tag);
+	}
+
+	template <class _T>
+	bool has(detail::static_any::compact_cell_kind, unsigned tag) const
+	{
+		return tag == compact::cell_tag && detail::static_any::holds_type<_T>(cell_function());
+	}
+
+	template <class _ValueT>
+	static std::uint64_t encode(detail::static_any::compact_double_kind, double value)
+	{
+		std::uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return value != value ? compact::quiet_nan : bits;
+	}
+
+	template <class _ValueT>
+	static std::uint64_t encode(detail::static_any::compact_small_kind, const _ValueT& value)
+	{
+		const std::uint64_t type_id = traits<_ValueT>::small_type_id();
+
+		std::uint32_t bits = 0;
+		std::memcpy(&bits, &value, sizeof(_ValueT));
+		return compact::box(compact::small_tag, type_id << 32 | bits);
+	}
+
+	template <class _ValueT>
+	static std::uint64_t encode(detail::static_any::compact_wide_kind, const _ValueT& value)
+	{
+		std::uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+
+		if (!compact::fits_in_payload(bits))
+			return make_cell<_ValueT>(value);
+
+		return compact::box(traits<_ValueT>::wide_tag(), bits);
+	}
+
+	template <class _ValueT, class _T>
+	static std::uint64_t encode(detail::static_any::compact_cell_kind, _T&& t)
+	{
+		return make_cell<_ValueT>(std::forward<_T>(t));
+	}
+
+	template <class _ValueT, class... Args>
+	static std::uint64_t emplace_bits(std::true_type, Args&&... args)
+	{
+		return encode<_ValueT>(typename traits<_ValueT>::kind{}, _ValueT(std::forward<Args>(args)...));
+	}
+
+	template <class _ValueT, class... Args>
+	static std::uint64_t emplace_bits(std::false_type, Args&&... args)
+	{
+		return make_cell<_ValueT>(std::forward<Args>(args)...);
+	}
+
+	template <class _ValueT>
+	_ValueT load(detail::static_any::compact_double_kind) const
+	{
+		double value;
+		std::memcpy(&value, &__bits, sizeof(value));
+		return value;
+	}
+
+	template <class _ValueT>
+	_ValueT load(detail::static_any::compact_small_kind) const
+	{
+		const std::uint32_t bits = static_cast<std::uint32_t>(__bits);
+		typename std::aligned_storage<sizeof(_ValueT), alignof(_ValueT)>::type value;
+		std::memcpy(&value, &bits, sizeof(_ValueT));
+		return *reinterpret_cast<const _ValueT*>(&value);
+	}
+
+	template <class _ValueT>
+	_ValueT load(detail::static_any::compact_wide_kind) const
+	{
+		const std::uint64_t bits = compact::sign_extend(compact::payload_of(__bits));
+		typename std::aligned_storage<sizeof(_ValueT), alignof(_ValueT)>::type value;
+		std::memcpy(&value, &bits, sizeof(_ValueT));
+		return *reinterpret_cast<const _ValueT*>(&value);
+	}
+
+	function_ptr_t query_function() const
+	{
+		const unsigned tag = compact::tag_of(__bits);
+		if (tag == compact::double_tag)
+			return detail::static_any::get_function_for_type<double>();
+		if (tag == compact::empty_tag)
+			return nullptr;
+		if (tag == compact::small_tag)
+			return detail::static_any::compact_small_types::table(small_type_id());
+		if (tag == compact::cell_tag)
+			return cell_function();
+		return detail::static_any::compact_wide_types::table(tag - compact::first_wide_tag + 1);
+	}
+
+	std::uint32_t small_type_id() const { return static_cast<std::uint32_t>(compact::payload_of(__bits) >> 32); }
+
+	void* cell() const { return reinterpret_cast<void*>(compact::payload_of(__bits)); }
+
+	function_ptr_t cell_function() const { return *static_cast<const function_ptr_t*>(cell()); }
+
+	void* cell_value() const { return static_cast<char*>(cell()) + compact::value_offset; }
+
+	static void* allocate_cell(std::size_t size)
+	{
+		void* cell = detail::static_any::pool::instance().allocate(compact::value_offset + size);
+		if ((reinterpret_cast<std::uintptr_t>(cell) & ~compact::payload_mask) != 0)
+		{
+			detail::static_any::pool::instance().deallocate(cell, compact::value_offset + size);
+			detail::static_any::raise(std::bad_alloc());
+		}
+		return cell;
+	}
+
+	static void deallocate_cell(void* cell, std::size_t size)
+	{
+		detail::static_any::pool::instance().deallocate(cell, compact::value_offset + size);
+	}
+
+	template <class _ValueT, class... Args>
+	static std::uint64_t make_cell(Args&&... args)
+	{
+		static_assert(alignof(_ValueT) <= alignof(std::max_align_t), "_T is over-aligned for static_any_compact");
+
+		void* cell = allocate_cell(sizeof(_ValueT));
+		STATIC_ANY_TRY
+		{
+			new(static_cast<char*>(cell) + compact::value_offset) _ValueT(std::forward<Args>(args)...);
+		}
+		STATIC_ANY_CATCH_ALL
+		{
+			deallocate_cell(cell, sizeof(_ValueT));
+			STATIC_ANY_RETHROW;
+		}
+
+		new(cell) function_ptr_t(detail::static_any::get_function_for_type<_ValueT>());
+		return compact::box(compact::cell_tag, reinterpret_cast<std::uintptr_t>(cell));
+	}
+
+	std::uint64_t copy_bits() const
+	{
+		if (compact::tag_of(__bits) != compact::cell_tag)
+			return __bits;
+
+		function_ptr_t function = cell_function();
+		void* cell = allocate_cell(function->size);
+		STATIC_ANY_TRY
+		{
+			function->copy(static_cast<char*>(cell) + compact::value_offset, cell_value());
+		}
+		STATIC_ANY_CATCH_ALL
+		{
+			deallocate_cell(cell, function->size);
+			STATIC_ANY_RETHROW;
+		}
+
+		new(cell) function_ptr_t(function);
+		return compact::box(compact::cell_tag, reinterpret_cast<std::uintptr_t>(cell));
+	}
+
+	void destroy()
+	{
+		if (compact::tag_of(__bits) == compact::cell_tag)
+		{
+			function_ptr_t function = cell_function();
+			if (!function->trivially_destructible)
+				function->destroy(cell_value());
+			deallocate_cell(cell(), function->size);
+		}
+		__bits = empty_bits;
+	}
+
+	std::uint64_t __bits = empty_bits;
+};
+
+template <class _ValueT,
+		  class _Compact,
+		  class = std::enable_if_t<std::is_same<std::remove_const_t<_Compact>, static_any_compact>::value>>
+inline decltype(auto) any_cast(_Compact& a)
+{
+	return a.template get<_ValueT>();
+}
+
+template <class _ValueT,
+		  class _Compact,
+		  class = std::enable_if_t<std::is_same<std::remove_const_t<_Compact>, static_any_compact>::value>>
+inline decltype(auto) any_cast(_Compact* a)
+{
+	return a->template get_if<_ValueT>();
+}
+
+} // inline namespace STATIC_ANY_ABI_NAMESPACE
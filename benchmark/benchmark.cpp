@@ -1,4 +1,5 @@
 #include "../any.hpp"
+#include "../tests/dyn_lib.hpp"
 
 #include <geiger/geiger.h>
 
@@ -178,6 +179,61 @@ int main()
 		sum += any_cast<std::string>(sstr).size();
 	});
 
+	// copies of a small value in large buffers: the whole buffer vs the stored bytes only
+	static_any_t<32> t32 = sss;
+	static_any_t<128> t128 = sss;
+	static_any_t<256> t256 = sss;
+	static_any_sized_t<32> st32 = sss;
+	static_any_sized_t<128> st128 = sss;
+	static_any_sized_t<256> st256 = sss;
+
+	s.add("static_any_t<32> copy small_struct", [&sum, &t32]()
+	{
+		static_any_t<32> a(t32);
+		sum += a.get<small_struct>().h();
+	});
+	s.add("static_any_sized_t<32> copy small_struct", [&sum, &st32]()
+	{
+		static_any_sized_t<32> a(st32);
+		sum += a.get<small_struct>().h();
+	});
+	s.add("static_any_t<128> copy small_struct", [&sum, &t128]()
+	{
+		static_any_t<128> a(t128);
+		sum += a.get<small_struct>().h();
+	});
+	s.add("static_any_sized_t<128> copy small_struct", [&sum, &st128]()
+	{
+		static_any_sized_t<128> a(st128);
+		sum += a.get<small_struct>().h();
+	});
+	s.add("static_any_t<256> copy small_struct", [&sum, &t256]()
+	{
+		static_any_t<256> a(t256);
+		sum += a.get<small_struct>().h();
+	});
+	s.add("static_any_sized_t<256> copy small_struct", [&sum, &st256]()
+	{
+		static_any_sized_t<256> a(st256);
+		sum += a.get<small_struct>().h();
+	});
+
+	static_any<16> local_int = 7;
+	static_any<16> dll_int = get_any_with_int(7);
+
+	s.add("static_any<16> has int", [&sum, &local_int]()
+	{
+		sum += local_int.has<int>();
+	});
+	s.add("static_any<16> has int across dll", [&sum, &dll_int]()
+	{
+		sum += dll_int.has<int>();
+	});
+	s.add("static_any<16> get int across dll", [&sum, &dll_int]()
+	{
+		sum += any_cast<int>(dll_int);
+	});
+
 	s.set_printer<geiger::printer::console<>>();
 	s.run();
 }
@@ -16,3 +16,6 @@ endforeach()
 
 add_library(gtest ${GOOGLETEST_SOURCES})
 
+# for the tests of static_any built without exceptions
+add_library(gtest_no_exceptions ${GOOGLETEST_SOURCES})
+
@@ -0,0 +1,50 @@
+#include "hidden_lib.hpp"
+
+namespace {
+
+struct First {};
+struct Second {};
+struct Third {};
+
+// registers other types first, so that the ids of this module differ from the ones of the tests
+void register_types()
+{
+	static const bool registered = (type_id_of<First>(), type_id_of<Second>(), type_id_of<Third>(), type_id_of<std::string>(), type_id_of<double>(), true);
+	(void)registered;
+}
+
+}
+
+std::uint32_t hidden_lib_type_id_of_int()
+{
+	register_types();
+	return type_id_of<int>();
+}
+
+static_any<32> get_hidden_any_with_int(int x)
+{
+	register_types();
+	static_any<32> a = x;
+	return a;
+}
+
+static_any<32> get_hidden_any_with_string(const char* str)
+{
+	register_types();
+	static_any<32> a = std::string(str);
+	return a;
+}
+
+static_any_compact get_hidden_compact_with_int(int x)
+{
+	register_types();
+	static_any_compact a = x;
+	return a;
+}
+
+static_any_compact get_hidden_compact_with_string(const char* str)
+{
+	register_types();
+	static_any_compact a = std::string(str);
+	return a;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "../any.hpp"
+
+// A module built with hidden visibility: it doesn't share the registries of the header with the tests
+#if defined(_MSC_VER)
+#define HIDDEN_LIB_API
+#else
+#define HIDDEN_LIB_API __attribute__((visibility("default")))
+#endif
+
+HIDDEN_LIB_API std::uint32_t hidden_lib_type_id_of_int();
+
+HIDDEN_LIB_API static_any<32> get_hidden_any_with_int(int x);
+HIDDEN_LIB_API static_any<32> get_hidden_any_with_string(const char* str);
+HIDDEN_LIB_API static_any_compact get_hidden_compact_with_int(int x);
+HIDDEN_LIB_API static_any_compact get_hidden_compact_with_string(const char* str);
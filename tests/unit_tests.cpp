@@ -1,8 +1,22 @@
 #include "../any.hpp"
 #include "dyn_lib.hpp"
+#include "hidden_lib.hpp"
 
 #include <gtest/gtest.h>
 
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+#ifdef STATIC_ANY_NO_EXCEPTIONS
+// the errors abort through the failure handler, and assignments don't back up the previous value
+#define EXPECT_ANY_ERROR(statement, exception) EXPECT_DEATH(statement, "")
+static constexpr int backup_copies = 0;
+#else
+#define EXPECT_ANY_ERROR(statement, exception) EXPECT_THROW(statement, exception)
+static constexpr int backup_copies = 1;
+#endif
+
 struct A
 {
 	explicit A(int i) :
@@ -37,6 +51,49 @@ TEST(any, test_sizeof)
 {
 	static_any<16> a;
 	ASSERT_EQ(16 + sizeof(std::ptrdiff_t), sizeof(a));
+
+	ASSERT_EQ(8u, sizeof(static_any_indexed<6>));
+	ASSERT_EQ(8u, sizeof(static_any_indexed<6, 4>));
+	ASSERT_EQ(8u, sizeof(static_any_indexed<4, 4, std::uint32_t>));
+	ASSERT_EQ(16u, sizeof(static_any_indexed<14>));
+}
+
+TEST(any, indexed)
+{
+	static_any_indexed<6, 4> a;
+	ASSERT_TRUE(a.empty());
+
+	a = 1234;
+	ASSERT_TRUE(a.has<int>());
+	ASSERT_EQ(1234, a.get<int>());
+	ASSERT_EQ(typeid(int), a.type());
+	ASSERT_EQ(type_id_of<int>(), a.type_id());
+
+	static_any_indexed<6, 4> b(a);
+	ASSERT_EQ(1234, b.get<int>());
+
+	b = short(7);
+	ASSERT_EQ(2u, b.size());
+	ASSERT_FALSE(b.has<int>());
+
+	a.reset();
+	ASSERT_TRUE(a.empty());
+}
+
+TEST(any, alignment)
+{
+	struct alignas(32) Aligned { char c[32]; };
+
+	static_any<32, 32> a = Aligned();
+	static_assert(sizeof(a) == 64, "buffer is padded to its alignment");
+	ASSERT_EQ(32, a.alignment());
+	ASSERT_EQ(0, reinterpret_cast<std::uintptr_t>(&a.get<Aligned>()) % 32);
+
+	static_any<8> b = .5;
+	ASSERT_EQ(0, reinterpret_cast<std::uintptr_t>(&b.get<double>()) % alignof(double));
+
+	static_any<32, 32> c = b;
+	ASSERT_EQ(.5, c.get<double>());
 }
 
 TEST(any, capacity)
@@ -181,9 +238,9 @@ TEST(any, value_copy_assignment)
 	a = counter;
 
 	ASSERT_EQ(0, CallCounter<0>::constructions);
-	ASSERT_EQ(1, CallCounter<0>::copy_constructions);
+	ASSERT_EQ(backup_copies, CallCounter<0>::copy_constructions);
 	ASSERT_EQ(0, CallCounter<0>::move_constructions);
-	ASSERT_EQ(2, CallCounter<0>::destructions);
+	ASSERT_EQ(1 + backup_copies, CallCounter<0>::destructions);
 
 	ASSERT_EQ(0, CallCounter<1>::constructions);
 	ASSERT_EQ(1, CallCounter<1>::copy_constructions);
@@ -202,9 +259,9 @@ TEST(any, value_move_assignment)
 	a = std::move(counter);
 
 	ASSERT_EQ(0, CallCounter<0>::constructions);
-	ASSERT_EQ(1, CallCounter<0>::copy_constructions);
+	ASSERT_EQ(backup_copies, CallCounter<0>::copy_constructions);
 	ASSERT_EQ(0, CallCounter<0>::move_constructions);
-	ASSERT_EQ(2, CallCounter<0>::destructions);
+	ASSERT_EQ(1 + backup_copies, CallCounter<0>::destructions);
 
 	ASSERT_EQ(0, CallCounter<1>::constructions);
 	ASSERT_EQ(0, CallCounter<1>::copy_constructions);
@@ -212,6 +269,116 @@ TEST(any, value_move_assignment)
 	ASSERT_EQ(0, CallCounter<1>::destructions);
 }
 
+TEST(any, value_nothrow_assignment_no_backup)
+{
+	static_any<16> a = CallCounter<0>();
+
+	CallCounter<0>::reset_counters();
+	a = 1234;
+
+	ASSERT_EQ(0, CallCounter<0>::copy_constructions);
+	ASSERT_EQ(0, CallCounter<0>::move_constructions);
+	ASSERT_EQ(1, CallCounter<0>::destructions);
+	ASSERT_EQ(1234, a.get<int>());
+}
+
+TEST(any, value_same_type_assignment_in_place)
+{
+	static_any<16> a = CallCounter<0>();
+	CallCounter<0> counter;
+
+	CallCounter<0>::reset_counters();
+	a = counter;
+	a = std::move(counter);
+
+	// CallCounter's assignment operators count as copy/move constructions
+	ASSERT_EQ(1, CallCounter<0>::copy_constructions);
+	ASSERT_EQ(1, CallCounter<0>::move_constructions);
+	ASSERT_EQ(0, CallCounter<0>::destructions);
+}
+
+TEST(any, value_same_type_assignment_keeps_capacity)
+{
+	static_any<32> a = std::string(100, 'x');
+	const char* data = a.get<std::string>().data();
+
+	const std::string hello("Hello");
+	a = hello;
+
+	ASSERT_EQ("Hello", a.get<std::string>());
+	ASSERT_EQ(data, a.get<std::string>().data());
+}
+
+TEST(any, basic_guarantee_no_backup)
+{
+	static_any_basic<16> a = CallCounter<0>();
+	static_any<16> b = CallCounter<1>();
+
+	CallCounter<0>::reset_counters();
+	CallCounter<1>::reset_counters();
+
+	a = b;
+	ASSERT_EQ(0, CallCounter<0>::copy_constructions);
+	ASSERT_EQ(0, CallCounter<0>::move_constructions);
+	ASSERT_EQ(1, CallCounter<0>::destructions);
+	ASSERT_EQ(1, CallCounter<1>::copy_constructions);
+
+	a = CallCounter<0>();
+	b = a;
+	ASSERT_TRUE(b.has<CallCounter<0>>());
+	static_assert(sizeof(a) == sizeof(b), "the guarantee doesn't change the layout");
+}
+
+TEST(any, indexed_from_hidden_module)
+{
+	static_any_indexed<32, 8> foreign = get_hidden_any_with_string("Hello");
+	static_any_indexed<32, 8> local = 5;
+
+	EXPECT_EQ("Hello", foreign.get<std::string>());
+	EXPECT_EQ(5, local.get<int>());
+	EXPECT_FALSE(local.has<std::string>());
+	EXPECT_EQ(type_id_of<std::string>(), foreign.type_id());
+}
+
+TEST(any, indexed_non_trivial)
+{
+	{
+		static_any_indexed<16, 8> a = CallCounter<0>();
+		static_any_indexed<16, 8, std::uint32_t> b(a);
+		static_any<16> c(b);
+		static_any_indexed<16, 8> d(c);
+		ASSERT_TRUE(d.has<CallCounter<0>>());
+
+		CallCounter<0>::reset_counters();
+		d = 1.5;
+		ASSERT_EQ(1, CallCounter<0>::destructions);
+		ASSERT_EQ(1.5, d.get<double>());
+	}
+	ASSERT_EQ(4, CallCounter<0>::destructions);
+}
+
+TEST(any, indexed_assignment_across_widths)
+{
+	static_any_indexed<32, 8, std::uint32_t> wide = std::string("Hello");
+	static_any_indexed<32, 8> narrow = std::string("world");
+	static_any<32> pointer = std::string("!");
+
+	narrow = wide;
+	EXPECT_EQ("Hello", narrow.get<std::string>());
+	pointer = narrow;
+	EXPECT_EQ("Hello", pointer.get<std::string>());
+	wide = pointer;
+	EXPECT_EQ("Hello", wide.get<std::string>());
+
+	wide = 7;
+	narrow = std::move(wide);
+	EXPECT_EQ(7, narrow.get<int>());
+	wide = narrow;
+	EXPECT_EQ(7, wide.get<int>());
+	narrow = pointer;
+	EXPECT_EQ("Hello", narrow.get<std::string>());
+}
+
 TEST(any, any_move_ctor)
 {
 	CallCounter<0> counter;
@@ -242,9 +409,9 @@ TEST(any, any_copy_assignment)
 	ASSERT_EQ(0, CallCounter<0>::destructions);
 
 	ASSERT_EQ(0, CallCounter<1>::constructions);
-	ASSERT_EQ(1, CallCounter<1>::copy_constructions);
+	ASSERT_EQ(backup_copies, CallCounter<1>::copy_constructions);
 	ASSERT_EQ(0, CallCounter<1>::move_constructions);
-	ASSERT_EQ(2, CallCounter<1>::destructions);
+	ASSERT_EQ(1 + backup_copies, CallCounter<1>::destructions);
 }
 
 TEST(any, any_move_assignment)
@@ -263,9 +430,44 @@ TEST(any, any_move_assignment)
 	ASSERT_EQ(0, CallCounter<0>::destructions);
 
 	ASSERT_EQ(0, CallCounter<1>::constructions);
-	ASSERT_EQ(1, CallCounter<1>::copy_constructions);
+	ASSERT_EQ(backup_copies, CallCounter<1>::copy_constructions);
+	ASSERT_EQ(0, CallCounter<1>::move_constructions);
+	ASSERT_EQ(1 + backup_copies, CallCounter<1>::destructions);
+}
+
+TEST(any, any_nothrow_assignment_no_backup)
+{
+	static_any<16> a(1234);
+	static_any<16> b = CallCounter<1>();
+
+	CallCounter<1>::reset_counters();
+	b = a;
+
+	ASSERT_EQ(0, CallCounter<1>::copy_constructions);
 	ASSERT_EQ(0, CallCounter<1>::move_constructions);
-	ASSERT_EQ(2, CallCounter<1>::destructions);
+	ASSERT_EQ(1, CallCounter<1>::destructions);
+	ASSERT_EQ(1234, b.get<int>());
+}
+
+TEST(any, any_same_type_assignment_in_place)
+{
+	static_any<16> a = CallCounter<0>();
+	static_any<32> b = CallCounter<0>();
+
+	CallCounter<0>::reset_counters();
+	b = a;
+	b = std::move(a);
+
+	ASSERT_EQ(1, CallCounter<0>::copy_constructions);
+	ASSERT_EQ(1, CallCounter<0>::move_constructions);
+	ASSERT_EQ(0, CallCounter<0>::destructions);
+}
+
+TEST(any, any_self_assignment)
+{
+	static_any<32> a(std::string("Hello"));
+	a = *&a;
+	ASSERT_EQ("Hello", a.get<std::string>());
 }
 
 TEST(any, not_empty_after_assignment)
@@ -296,19 +498,19 @@ TEST(any, get_good_type)
 TEST(any, get_bad_type)
 {
 	static_any<16> a(7);
-	EXPECT_THROW(a.get<double>(), std::bad_cast);
+	EXPECT_ANY_ERROR(a.get<double>(), std::bad_cast);
 }
 
 TEST(any, get_empty)
 {
 	static_any<16> a;
-	EXPECT_THROW(a.get<double>(), std::bad_cast);
+	EXPECT_ANY_ERROR(a.get<double>(), std::bad_cast);
 }
 
 TEST(any, cast_empty)
 {
 	static_any<16> a;
-	EXPECT_THROW(any_cast<int>(a), std::bad_cast);
+	EXPECT_ANY_ERROR(any_cast<int>(a), std::bad_cast);
 }
 
 TEST(any, mutable_get)
@@ -320,6 +522,68 @@ TEST(any, mutable_get)
 	ASSERT_EQ(6, i);
 }
 
+TEST(any, get_if)
+{
+	static_any<16> a(7);
+	const static_any<16>& const_ref = a;
+
+	static_assert(noexcept(a.get_if<int>()), "get_if must not throw");
+	ASSERT_EQ(nullptr, a.get_if<double>());
+	ASSERT_EQ(nullptr, static_any<16>().get_if<int>());
+
+	*a.get_if<int>() = 6;
+	ASSERT_EQ(6, *const_ref.get_if<int>());
+}
+
+TEST(any, try_get)
+{
+	static_any<16> a(7);
+
+	static_assert(noexcept(a.try_get<int>()), "try_get must not throw");
+	auto i = a.try_get<int>();
+	ASSERT_TRUE(i.has_value());
+	ASSERT_EQ(7, *i);
+	*i = 6;
+	ASSERT_EQ(6, a.get<int>());
+
+	const static_any<16>& const_ref = a;
+	auto d = const_ref.try_get<double>();
+	ASSERT_FALSE(d);
+	ASSERT_EQ(typeid(int), d.error());
+	ASSERT_EQ(1.5, d.value_or(1.5));
+	EXPECT_ANY_ERROR(d.value(), bad_any_cast);
+
+	ASSERT_EQ(typeid(void), static_any<16>().try_get<int>().error());
+}
+
+TEST(any, bad_any_cast_lazy_what)
+{
+	bad_any_cast ex(typeid(int), typeid(double));
+	const std::string what = ex.what();
+	ASSERT_NE(std::string::npos, what.find(typeid(int).name()));
+	ASSERT_NE(std::string::npos, what.find(typeid(double).name()));
+	ASSERT_EQ(ex.what(), ex.what());
+
+	// copies share the message once built
+	const bad_any_cast copy(ex);
+	ASSERT_EQ(ex.what(), copy.what());
+}
+
+TEST(any, bad_any_cast_what_from_threads)
+{
+	const bad_any_cast ex(typeid(int), typeid(double));
+
+	const char* whats[4] = {};
+	std::vector<std::thread> threads;
+	for (const char*& what : whats)
+		threads.emplace_back([&ex, &what]() { what = ex.what(); });
+	for (std::thread& thread : threads)
+		thread.join();
+
+	for (const char* what : whats)
+		ASSERT_EQ(ex.what(), what);
+}
+
 TEST(any, any_to_any_copy_uninitialized)
 {
 	static_any<16> a;
@@ -351,6 +615,23 @@ TEST(any, any_to_any_assignment)
 	ASSERT_EQ("Hello", a.get<std::string>());
 }
 
+TEST(any, any_to_any_assignment_from_empty)
+{
+	static_any<32> a(std::string("Hello"));
+	static_any<32> b;
+	a = b;
+	ASSERT_TRUE(a.empty());
+
+	static_any<32> c(7);
+	static_any<16> d;
+	c = std::move(d);
+	ASSERT_TRUE(c.empty());
+
+	static_any<32> e(7);
+	ASSERT_TRUE(e.try_assign(static_any<64>()));
+	ASSERT_TRUE(e.empty());
+}
+
 TEST(any, any_to_any_move_construction)
 {
 	static_any<32> a(std::string("Hello"));
@@ -382,6 +663,24 @@ TEST(any, any_to_bigger_any_copy)
 	ASSERT_EQ(1, b.get<int>());
 }
 
+TEST(any, trivially_copyable_copy)
+{
+	struct POD { int i; float f; char c[4]; };
+
+	static_any<16> a = POD{7, .5f, {'a', 'b', 'c', '\0'}};
+	static_any<16> b(a);
+	static_any<32> c(a);
+	static_any<32> d(std::string("Hello"));
+	d = b;
+
+	for (const POD& pod : {a.get<POD>(), b.get<POD>(), c.get<POD>(), d.get<POD>()})
+	{
+		EXPECT_EQ(7, pod.i);
+		EXPECT_EQ(.5f, pod.f);
+		EXPECT_STREQ("abc", pod.c);
+	}
+}
+
 struct InitCtor
 {
 	InitCtor() = default;
@@ -411,6 +710,53 @@ TEST(any, emplace_params)
 	EXPECT_EQ(88, a.get<InitCtor>().y);
 }
 
+struct NonMovable
+{
+	explicit NonMovable(int i) : m_i(i) {}
+	NonMovable(const NonMovable&) = delete;
+	NonMovable& operator=(const NonMovable&) = delete;
+	~NonMovable() {}
+
+	int m_i;
+};
+
+TEST(any, in_place_construction)
+{
+	static_any<32> a(in_place_type<InitCtor>, 77, 88);
+	EXPECT_EQ(77, a.get<InitCtor>().x);
+	EXPECT_EQ(88, a.get<InitCtor>().y);
+
+	CallCounter<0>::reset_counters();
+	static_any<8> b(in_place_type<CallCounter<0>>);
+	EXPECT_EQ(1, CallCounter<0>::constructions);
+	EXPECT_EQ(0, CallCounter<0>::move_constructions);
+	EXPECT_EQ(0, CallCounter<0>::copy_constructions);
+
+	static_any<8> c(in_place_type<NonMovable>, 7);
+	EXPECT_EQ(7, c.get<NonMovable>().m_i);
+	EXPECT_ANY_ERROR(static_any<8> d(std::move(c)), bad_any_copy);
+
+	c = 1;
+	EXPECT_EQ(1, c.get<int>());
+}
+
+TEST(any, make_static_any)
+{
+	auto a = make_static_any<std::string>(3, 'x');
+	static_assert(decltype(a)::capacity() == sizeof(std::string), "");
+	EXPECT_EQ("xxx", a.get<std::string>());
+
+	auto b = make_static_any<int, 16>(7);
+	static_assert(decltype(b)::capacity() == 16, "");
+	static_assert(decltype(b)::alignment() == detail::static_any::default_alignment, "");
+	EXPECT_EQ(7, b.get<int>());
+
+	static_assert(static_any_for<char, int, std::string>::capacity() == sizeof(std::string), "");
+	static_assert(static_any_for<char, short>::alignment() == detail::static_any::default_alignment, "");
+	struct alignas(32) Aligned { char c[32]; };
+	static_assert(static_any_for<char, Aligned>::alignment() == 32, "");
+}
+
 TEST(any, destroyed_after_emplace)
 {
 	CallCounter<0>::reset_counters();
@@ -476,9 +822,11 @@ TEST(any, any_cast_reference_constness)
 TEST(any, any_cast_reference_wrong_type)
 {
 	static_any<16> a(7);
-	EXPECT_THROW(any_cast<float>(a), bad_any_cast);
+	EXPECT_ANY_ERROR(any_cast<float>(a), bad_any_cast);
 }
 
+#ifndef STATIC_ANY_NO_EXCEPTIONS
+
 TEST(any, any_cast_reference_wrong_type_from_to)
 {
 	static_any<16> a(7);
@@ -494,6 +842,8 @@ TEST(any, any_cast_reference_wrong_type_from_to)
 	}
 }
 
+#endif
+
 TEST(any, query_type)
 {
 	static_any<32> a(7);
@@ -503,6 +853,40 @@ TEST(any, query_type)
 	ASSERT_EQ(typeid(std::string), a.type());
 }
 
+TEST(any, function_table_is_constant)
+{
+	constexpr const auto& int_table = detail::static_any::operations<int>::table;
+	static_assert(int_table.size == sizeof(int), "table built at compile time");
+	static_assert(int_table.alignment == alignof(int), "table built at compile time");
+	static_assert(int_table.trivially_copyable && int_table.trivially_destructible, "int is trivial");
+
+	constexpr const auto& string_table = detail::static_any::operations<std::string>::table;
+	static_assert(!string_table.trivially_copyable && !string_table.trivially_destructible, "std::string is not trivial");
+
+	EXPECT_EQ(&typeid(std::string), string_table.type);
+}
+
+TEST(any, trivial_operations_are_shared)
+{
+	detail::static_any::function_ptr_t int_table = detail::static_any::get_function_for_type<int>();
+	detail::static_any::function_ptr_t float_table = detail::static_any::get_function_for_type<float>();
+	ASSERT_NE(int_table, float_table);
+	EXPECT_EQ(int_table->copy, float_table->copy);
+	EXPECT_EQ(int_table->move, float_table->move);
+	EXPECT_EQ(int_table->destroy, float_table->destroy);
+	EXPECT_NE(int_table->type_id, float_table->type_id);
+
+	detail::static_any::function_ptr_t string_table = detail::static_any::get_function_for_type<std::string>();
+	EXPECT_NE(int_table->copy, string_table->copy);
+
+	static_any<8> a = 1.5f;
+	ASSERT_TRUE(a.has<float>());
+	ASSERT_FALSE(a.has<int>());
+
+	static_any<8> b = a;
+	ASSERT_EQ(1.5f, b.get<float>());
+}
+
 TEST(any, reset_empty)
 {
 	static_any<16> a(7);
@@ -527,7 +911,38 @@ TEST(any, type_identification_across_dll)
 
 	EXPECT_EQ(7, a.get<int>());
 
-	EXPECT_THROW(a.get<std::string>(), bad_any_cast);
+	EXPECT_ANY_ERROR(a.get<std::string>(), bad_any_cast);
+}
+
+TEST(any, foreign_table_cache)
+{
+	struct Foreign {};
+
+	// a copy of the table stands for the one of the same type in another module
+	static const detail::static_any::function_table_t foreign_table = detail::static_any::operations<Foreign>::table;
+	using foreign_tables = detail::static_any::foreign_tables<Foreign>;
+
+	EXPECT_FALSE(foreign_tables::contains(&foreign_table));
+	EXPECT_FALSE(detail::static_any::holds_type<int>(&foreign_table));
+	EXPECT_FALSE(foreign_tables::contains(&foreign_table));
+
+	EXPECT_TRUE(detail::static_any::holds_type<Foreign>(&foreign_table));
+	EXPECT_TRUE(foreign_tables::contains(&foreign_table));
+	EXPECT_TRUE(detail::static_any::holds_type<const Foreign>(&foreign_table));
+}
+
+TEST(any, foreign_table_cache_address_reuse)
+{
+	struct Unloaded {};
+	struct Reloaded { int i; };
+
+	// a module unloaded, then another one loaded with a table of another type at the same address
+	static detail::static_any::function_table_t table = detail::static_any::operations<Unloaded>::table;
+	ASSERT_TRUE(detail::static_any::holds_type<Unloaded>(&table));
+
+	table = detail::static_any::operations<Reloaded>::table;
+	EXPECT_FALSE(detail::static_any::holds_type<Unloaded>(&table));
+	EXPECT_TRUE(detail::static_any::holds_type<Reloaded>(&table));
 }
 
 TEST(any_t, simple)
@@ -536,6 +951,90 @@ TEST(any_t, simple)
 	ASSERT_EQ(7, a.get<int>());
 }
 
+TEST(any_t, alignment)
+{
+	struct alignas(16) Aligned { double d[2]; };
+
+	static_any_t<32, 16> a = Aligned{{.5, .25}};
+	ASSERT_EQ(0, reinterpret_cast<std::uintptr_t>(&a.get<Aligned>()) % 16);
+	ASSERT_EQ(.25, a.get<Aligned>().d[1]);
+}
+
+TEST(any_t, unchecked_layout)
+{
+	static_assert(sizeof(static_any_t<16, 8, false>) == 16, "an unchecked static_any_t has no overhead");
+	static_assert(sizeof(static_any_t<3, 1, false>) == 3, "an unchecked static_any_t has no overhead");
+
+#if !defined(STATIC_ANY_T_CHECKED) || defined(NDEBUG)
+	static_assert(sizeof(static_any_t<16>) == 16, "static_any_t is unchecked by default");
+	static_assert(sizeof(static_any_t<3>) == 3, "the default alignment doesn't pad the buffer");
+	static_assert(sizeof(static_any_t<4>) == 4, "the default alignment doesn't pad the buffer");
+	static_assert(sizeof(static_any_t<12>) == 12, "the default alignment doesn't pad the buffer");
+	static_assert(alignof(static_any_t<12>) == 4, "aligned on the biggest power of two dividing the size");
+#endif
+}
+
+TEST(any_t, checked)
+{
+	using checked_any_t = static_any_t<16, 8, true>;
+
+	checked_any_t a(7);
+	ASSERT_EQ(7, a.get<int>());
+
+	checked_any_t b;
+	b = a;
+	ASSERT_EQ(7, b.get<int>());
+
+	b = 1.5;
+	ASSERT_EQ(1.5, b.get<double>());
+
+#ifndef NDEBUG
+	EXPECT_DEATH(b.get<int>(), "doesn't hold the requested type");
+	EXPECT_DEATH(checked_any_t().get<int>(), "doesn't hold the requested type");
+#endif
+}
+
+TEST(any_sized_t, layout)
+{
+	static_assert(sizeof(static_any_sized_t<7, 1>) == 8, "the size is stored on 1 byte");
+	static_assert(sizeof(static_any_sized_t<256, 2>) == 258, "the size is stored on 2 bytes");
+	static_assert(sizeof(static_any_sized_t<256>) == 264, "padded to the alignment");
+}
+
+TEST(any_sized_t, size_and_copy)
+{
+	struct POD { int i; float f; char c[4]; };
+
+	static_any_sized_t<256> a;
+	ASSERT_TRUE(a.empty());
+	ASSERT_EQ(0u, a.size());
+
+	a = POD{1, 2.f, {'a', 'b', 'c', 0}};
+	ASSERT_FALSE(a.empty());
+	ASSERT_EQ(sizeof(POD), a.size());
+
+	static_any_sized_t<256> b(a);
+	ASSERT_EQ(sizeof(POD), b.size());
+	ASSERT_EQ(2.f, b.get<POD>().f);
+
+	b = 7;
+	ASSERT_EQ(sizeof(int), b.size());
+	ASSERT_EQ(7, b.get<int>());
+
+	a = b;
+	ASSERT_EQ(7, a.get<int>());
+
+	a.reset();
+	ASSERT_TRUE(a.empty());
+
+	using Chars = std::array<char, 13>;
+	static_any_sized_t<13, 1> c = Chars{{'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm'}};
+	static_any_sized_t<13, 1> d(c);
+	ASSERT_EQ('m', d.get<Chars>()[12]);
+}
+
+#ifndef STATIC_ANY_NO_EXCEPTIONS
+
 class UnsafeCopy
 {
 public:
@@ -591,13 +1090,36 @@ private:
 
 TEST(any, assignment_strong_guarantee)
 {
-	static_any<16> a(UnsafeCopy(42));
+	static_any<16> a(UnsafeCopy(7));
+	UnsafeCopy u(42);
 
-	CallCounter<0>::reset_counters();
-	EXPECT_THROW(a = 5, std::runtime_error);
+	EXPECT_THROW(a = u, std::runtime_error);
 
 	ASSERT_FALSE(a.empty());
-	EXPECT_EQ(42, a.get<UnsafeCopy>().get());
+	EXPECT_EQ(7, a.get<UnsafeCopy>().get());
+}
+
+TEST(any, nothrow_assignment_skips_backup)
+{
+	static_any<16> a(UnsafeCopy(42));
+
+	// the previous value is not backed up, so its throwing copy constructor is never called
+	EXPECT_NO_THROW(a = 5);
+	EXPECT_EQ(5, a.get<int>());
+}
+
+TEST(any, basic_guarantee_assignment)
+{
+	static_any_basic<16> a(UnsafeCopy(7));
+	UnsafeCopy u(42);
+
+	EXPECT_THROW(a = u, std::runtime_error);
+	EXPECT_TRUE(a.empty());
+
+	static_any<16> b(UnsafeCopy(42));
+	a = 5;
+	EXPECT_THROW(a = b, std::runtime_error);
+	EXPECT_TRUE(a.empty());
 }
 
 TEST(any_exception, init)
@@ -678,4 +1200,939 @@ TEST(any_exception, move_from_different_any)
 	EXPECT_EQ(1234, b.get<int>());
 }
 
+#endif
+
+TEST(any, move_only_type)
+{
+	static_any<16> a(std::unique_ptr<int>(new int(7)));
+	ASSERT_EQ(7, *a.get<std::unique_ptr<int>>());
+
+	static_any<16> b(std::move(a));
+	ASSERT_EQ(7, *b.get<std::unique_ptr<int>>());
+
+	a = std::unique_ptr<int>(new int(8));
+	ASSERT_EQ(8, *a.get<std::unique_ptr<int>>());
 
+	b = std::move(a);
+	ASSERT_EQ(8, *b.get<std::unique_ptr<int>>());
+}
+
+TEST(any, move_only_container_in_vector)
+{
+	static_assert(!std::is_copy_constructible<static_any_move_only<16>>::value, "");
+	static_assert(std::is_move_constructible<static_any_move_only<16>>::value, "");
+
+	std::vector<static_any_move_only<16>> v;
+	for (int i = 0; i < 100; ++i)
+		v.emplace_back(std::unique_ptr<int>(new int(i)));
+
+	for (int i = 0; i < 100; ++i)
+		EXPECT_EQ(i, *any_cast<std::unique_ptr<int>>(v[static_cast<std::size_t>(i)]));
+
+	static_any_move_only<16> a(in_place_type<std::unique_ptr<int>>, new int(7));
+	a = std::move(v.back());
+	EXPECT_EQ(99, *a.get<std::unique_ptr<int>>());
+}
+
+TEST(any, move_only_type_copy)
+{
+	static_any<16> a(std::unique_ptr<int>(new int(7)));
+
+	EXPECT_ANY_ERROR(static_any<16> b(a), bad_any_copy);
+
+	static_any<16> c(1234);
+	EXPECT_ANY_ERROR(c = a, bad_any_copy);
+	EXPECT_EQ(1234, c.get<int>());
+
+#ifndef STATIC_ANY_NO_EXCEPTIONS
+	try {
+		static_any<16> d(a);
+		FAIL();
+	}
+	catch(bad_any_copy& ex) {
+		EXPECT_EQ(typeid(std::unique_ptr<int>), ex.stored_type());
+	}
+#endif
+}
+
+TEST(any, trivially_copyable_move_only_type_copy)
+{
+	struct MoveOnly
+	{
+		MoveOnly(int i) : m_i(i) {}
+		MoveOnly(MoveOnly&&) = default;
+		MoveOnly(const MoveOnly&) = delete;
+
+		int m_i;
+	};
+	static_assert(std::is_trivially_copyable<MoveOnly>::value, "copied bytewise unless the copy is checked");
+
+	static_any<16> a(in_place_type<MoveOnly>, 7);
+	EXPECT_ANY_ERROR(static_any<16> b(a), bad_any_copy);
+	EXPECT_ANY_ERROR(static_any<32> c(a), bad_any_copy);
+
+	static_any<16> d(std::move(a));
+	EXPECT_EQ(7, d.get<MoveOnly>().m_i);
+
+	static_any_sbo<16> e(MoveOnly(7));
+	EXPECT_ANY_ERROR(static_any_sbo<16> f(e), bad_any_copy);
+}
+
+struct Relocatable
+{
+	explicit Relocatable(int i) : m_i(i) {}
+	Relocatable(const Relocatable& r) : m_i(r.m_i) { ++moves; }
+	~Relocatable() { ++destructions; }
+
+	int m_i;
+	static int moves;
+	static int destructions;
+};
+
+int Relocatable::moves = 0;
+int Relocatable::destructions = 0;
+
+template <>
+struct is_trivially_relocatable<Relocatable> : public std::true_type {};
+
+TEST(any, relocate_trivially_relocatable)
+{
+	using any_t = static_any<16>;
+	alignas(any_t) char from[4 * sizeof(any_t)];
+	alignas(any_t) char to[4 * sizeof(any_t)];
+
+	any_t* first = reinterpret_cast<any_t*>(from);
+	new(first) any_t(1);
+	new(first + 1) any_t();
+	new(first + 2) any_t(Relocatable(7));
+	new(first + 3) any_t(2.5);
+
+	Relocatable::moves = 0;
+	Relocatable::destructions = 0;
+
+	any_t* d_first = reinterpret_cast<any_t*>(to);
+	ASSERT_EQ(d_first + 4, uninitialized_relocate(first, first + 4, d_first));
+	EXPECT_EQ(0, Relocatable::moves);
+	EXPECT_EQ(0, Relocatable::destructions);
+
+	EXPECT_EQ(1, d_first[0].get<int>());
+	EXPECT_TRUE(d_first[1].empty());
+	EXPECT_EQ(7, d_first[2].get<Relocatable>().m_i);
+	EXPECT_EQ(2.5, d_first[3].get<double>());
+
+	for (int i = 0; i < 4; ++i)
+		d_first[i].~any_t();
+	EXPECT_EQ(1, Relocatable::destructions);
+}
+
+TEST(any, relocate_non_trivial)
+{
+	using any_t = static_any<32>;
+	alignas(any_t) char from[3 * sizeof(any_t)];
+	alignas(any_t) char to[3 * sizeof(any_t)];
+
+	any_t* first = reinterpret_cast<any_t*>(from);
+	new(first) any_t(std::string(100, 'x'));
+	new(first + 1) any_t(CallCounter<0>());
+	new(first + 2) any_t(3);
+
+	CallCounter<0>::reset_counters();
+	any_t* d_first = reinterpret_cast<any_t*>(to);
+	uninitialized_relocate(first, first + 3, d_first);
+	EXPECT_EQ(1, CallCounter<0>::move_constructions);
+	EXPECT_EQ(1, CallCounter<0>::destructions);
+
+	EXPECT_EQ(std::string(100, 'x'), d_first[0].get<std::string>());
+	EXPECT_TRUE(d_first[1].has<CallCounter<0>>());
+	EXPECT_EQ(3, d_first[2].get<int>());
+
+	for (int i = 0; i < 3; ++i)
+		d_first[i].~any_t();
+	EXPECT_EQ(2, CallCounter<0>::destructions);
+}
+
+TEST(any, swap_trivial)
+{
+	static_any<16> a = 1;
+	static_any<16> b = 2.5;
+	a.swap(b);
+	EXPECT_EQ(2.5, a.get<double>());
+	EXPECT_EQ(1, b.get<int>());
+
+	static_any<16> empty;
+	using std::swap;
+	swap(a, empty);
+	EXPECT_TRUE(a.empty());
+	EXPECT_EQ(2.5, empty.get<double>());
+}
+
+TEST(any, swap_non_trivial)
+{
+	static_any<32> a = std::string("Hello");
+	static_any<32> b = CallCounter<0>();
+
+	CallCounter<0>::reset_counters();
+	swap(a, b);
+	EXPECT_TRUE(a.has<CallCounter<0>>());
+	EXPECT_EQ("Hello", b.get<std::string>());
+	EXPECT_EQ(1, CallCounter<0>::move_constructions);
+	EXPECT_EQ(1, CallCounter<0>::destructions);
+	EXPECT_EQ(0, CallCounter<0>::copy_constructions);
+
+	b = 7;
+	swap(a, b);
+	EXPECT_EQ(7, a.get<int>());
+	EXPECT_TRUE(b.has<CallCounter<0>>());
+}
+
+TEST(any, swap_different_sizes)
+{
+	static_any<8> a = 1;
+	static_any<32> b = 2.5;
+	swap(a, b);
+	EXPECT_EQ(2.5, a.get<double>());
+	EXPECT_EQ(1, b.get<int>());
+
+	b = std::string("Hello");
+	EXPECT_ANY_ERROR(swap(b, a), std::length_error);
+	EXPECT_EQ(2.5, a.get<double>());
+	EXPECT_EQ("Hello", b.get<std::string>());
+}
+
+TEST(any, try_narrow)
+{
+	static_any<128> wide = 7;
+	static_any<16> narrow;
+	ASSERT_TRUE(try_narrow(wide, narrow));
+	EXPECT_EQ(7, narrow.get<int>());
+	EXPECT_EQ(7, wide.get<int>());
+
+	wide = std::string("Hello");
+	static_any<32> string_any;
+	ASSERT_TRUE(try_narrow(std::move(wide), string_any));
+	EXPECT_EQ("Hello", string_any.get<std::string>());
+
+	wide = std::array<char, 64>();
+	EXPECT_FALSE(try_narrow(wide, narrow));
+	EXPECT_EQ(7, narrow.get<int>());
+
+	wide.reset();
+	ASSERT_TRUE(try_narrow(wide, narrow));
+	EXPECT_TRUE(narrow.empty());
+}
+
+TEST(any, narrow_cast)
+{
+	static_any<128> wide = 2.5;
+	auto narrow = narrow_cast<static_any<8>>(wide);
+	EXPECT_EQ(2.5, narrow.get<double>());
+
+	wide = std::string("Hello");
+	EXPECT_ANY_ERROR(narrow_cast<static_any<8>>(wide), std::length_error);
+}
+
+TEST(any_t, swap)
+{
+	static_any_t<16> a = 1;
+	static_any_t<16> b = 2.5;
+	swap(a, b);
+	EXPECT_EQ(2.5, a.get<double>());
+	EXPECT_EQ(1, b.get<int>());
+}
+
+#ifndef STATIC_ANY_NO_EXCEPTIONS
+
+TEST(any, move_only_type_backup)
+{
+	static_any<16> a(std::unique_ptr<int>(new int(7)));
+	UnsafeCopy u(42);
+
+	// the backup of the stored unique_ptr is done by moving it
+	EXPECT_THROW(a = u, std::runtime_error);
+	EXPECT_EQ(7, *a.get<std::unique_ptr<int>>());
+}
+
+#else
+
+TEST(any_no_exceptions, failure_handler)
+{
+	static_any<16> a(7);
+
+	EXPECT_DEATH(
+	{
+		set_static_any_failure_handler([](const std::exception& ex) { std::fputs(ex.what(), stderr); std::abort(); });
+		a.get<double>();
+	}, "failed conversion using any_cast");
+}
+
+#endif
+
+TEST(any_sbo, inline_value)
+{
+	static_any_sbo<16> a(7);
+	ASSERT_TRUE(a.stored_inline());
+	ASSERT_TRUE(a.has<int>());
+	ASSERT_EQ(7, a.get<int>());
+	ASSERT_EQ(sizeof(int), a.size());
+}
+
+TEST(any_sbo, spilled_value)
+{
+	struct Big { std::array<char, 64> c; int i; };
+
+	static_any_sbo<16> a = Big{{}, 42};
+	ASSERT_FALSE(a.stored_inline());
+	ASSERT_TRUE(a.has<Big>());
+	ASSERT_FALSE(a.has<int>());
+	ASSERT_EQ(42, a.get<Big>().i);
+	ASSERT_EQ(42, any_cast<Big>(&a)->i);
+	ASSERT_EQ(nullptr, any_cast<int>(&a));
+	EXPECT_ANY_ERROR(a.get<int>(), bad_any_cast);
+
+	a = 7;
+	ASSERT_TRUE(a.stored_inline());
+	ASSERT_EQ(7, a.get<int>());
+
+	a = std::string(100, 'x');
+	ASSERT_EQ(typeid(std::string), a.type());
+}
+
+TEST(any_sbo, spilled_copy_and_move)
+{
+	static_any_sbo<8> a = std::string("Hello");
+	ASSERT_FALSE(a.stored_inline());
+
+	static_any_sbo<8> b(a);
+	ASSERT_EQ("Hello", a.get<std::string>());
+	ASSERT_EQ("Hello", b.get<std::string>());
+	ASSERT_NE(&a.get<std::string>(), &b.get<std::string>());
+
+	const std::string* stored = &b.get<std::string>();
+	static_any_sbo<8> c(std::move(b));
+	ASSERT_TRUE(b.empty());
+	ASSERT_EQ(stored, &c.get<std::string>());
+
+	c = a;
+	ASSERT_EQ(stored, &c.get<std::string>());
+	ASSERT_EQ("Hello", c.get<std::string>());
+
+	c = b;
+	ASSERT_TRUE(c.empty());
+}
+
+TEST(any_sbo, other_sizes_are_not_values)
+{
+	static_assert(!std::is_constructible<static_any_sbo<8>, static_any_sbo<32>>::value, "not stored as a value");
+	static_assert(!std::is_assignable<static_any_sbo<8>&, const static_any_sbo<32>&>::value, "not stored as a value");
+	static_assert(!std::is_assignable<static_any_sbo<8>&, static_any_cow<8>>::value, "not stored as a value");
+	static_assert(!std::is_constructible<static_any_cow<8>, const static_any_cow<32>&>::value, "not stored as a value");
+	static_assert(!std::is_assignable<static_any_cow<8>&, static_any_cow<32>>::value, "not stored as a value");
+
+	static_assert(sizeof(static_any_sbo<16>) == 16 + sizeof(void*), "the tag doesn't change the layout");
+	static_assert(sizeof(static_any_cow<16>) == 16 + sizeof(void*), "the tag doesn't change the layout");
+}
+
+TEST(any_sbo, destruction)
+{
+	struct BigCounter { CallCounter<0> counter; std::array<char, 64> c; };
+
+	CallCounter<0>::reset_counters();
+	{
+		static_any_sbo<16> a;
+		a.emplace<BigCounter>();
+		ASSERT_FALSE(a.stored_inline());
+
+		static_any_sbo<16> b(a);
+		a = 7;
+		b.reset();
+	}
+
+	EXPECT_EQ(1, CallCounter<0>::constructions);
+	EXPECT_EQ(1, CallCounter<0>::copy_constructions);
+	EXPECT_EQ(2, CallCounter<0>::destructions);
+}
+
+#ifndef STATIC_ANY_NO_EXCEPTIONS
+
+TEST(any_sbo, spill_exception)
+{
+	struct BigUnsafe { UnsafeCopy u; std::array<char, 64> c; };
+
+	static_any_sbo<16> a(1234);
+	BigUnsafe big{UnsafeCopy(42), {}};
+
+	EXPECT_THROW(a = big, std::runtime_error);
+	EXPECT_EQ(1234, a.get<int>());
+}
+
+#endif
+
+TEST(any_sbo, pool_reuses_blocks)
+{
+	using Array100 = std::array<char, 100>;
+	using Array120 = std::array<char, 120>;
+
+	detail::static_any::pool& pool = detail::static_any::pool::instance();
+	{
+		static_any_sbo<8> a = Array100();
+	}
+	const std::size_t cached = pool.cached_blocks(sizeof(Array100));
+	ASSERT_LT(0u, cached);
+
+	// both are in the same size class: the block released by a is taken again
+	static_any_sbo<8> b = Array120();
+	ASSERT_EQ(cached - 1, pool.cached_blocks(sizeof(Array120)));
+	ASSERT_EQ(cached - 1, pool.cached_blocks(sizeof(Array100)));
+}
+
+TEST(any_pmr, spill_to_arena)
+{
+	using Big = std::array<char, 64>;
+	static_any_arena arena;
+
+	static_any_pmr<16, static_any_arena> a(std::allocator_arg, &arena);
+	a = 7;
+	ASSERT_TRUE(a.stored_inline());
+
+	a = Big{{'x'}};
+	ASSERT_FALSE(a.stored_inline());
+	ASSERT_EQ('x', a.get<Big>()[0]);
+	ASSERT_EQ(&arena, a.get_allocator().resource());
+
+	// copies share the resource
+	static_any_pmr<16, static_any_arena> b(a);
+	ASSERT_EQ(&arena, b.get_allocator().resource());
+	ASSERT_EQ('x', b.get<Big>()[0]);
+}
+
+TEST(any_pmr, destroy_runs_destructor)
+{
+	struct BigCounter { CallCounter<0> counter; std::array<char, 64> c; };
+	static_any_arena arena;
+
+	CallCounter<0>::reset_counters();
+	{
+		static_any_pmr<16, static_any_arena> a(std::allocator_arg, &arena, BigCounter());
+		ASSERT_FALSE(a.stored_inline());
+	}
+
+	EXPECT_EQ(1, CallCounter<0>::constructions);
+	EXPECT_EQ(1, CallCounter<0>::move_constructions);
+	EXPECT_EQ(2, CallCounter<0>::destructions);
+}
+
+TEST(any_pmr, move_between_resources)
+{
+	static_any_arena arena1;
+	static_any_arena arena2;
+
+	static_any_pmr<8, static_any_arena> a(std::allocator_arg, &arena1, std::string(100, 'x'));
+	static_any_pmr<8, static_any_arena> b(std::allocator_arg, &arena2);
+
+	b = std::move(a);
+	ASSERT_TRUE(a.empty());
+	ASSERT_EQ(&arena2, b.get_allocator().resource());
+	ASSERT_EQ(std::string(100, 'x'), b.get<std::string>());
+}
+
+TEST(any_pmr, no_resource)
+{
+	static_any_pmr<8, static_any_arena> a;
+	a = 7;
+	ASSERT_EQ(7, a.get<int>());
+
+	EXPECT_ANY_ERROR(a = std::string("Hello"), std::bad_alloc);
+	EXPECT_EQ(7, a.get<int>());
+}
+
+TEST(any_arena, alignment)
+{
+	static_any_arena arena(64);
+
+	void* p1 = arena.allocate(1, 1);
+	void* p2 = arena.allocate(8, 32);
+	void* p3 = arena.allocate(200, 8);
+
+	ASSERT_NE(nullptr, p1);
+	ASSERT_EQ(0, reinterpret_cast<std::uintptr_t>(p2) % 32);
+	ASSERT_EQ(0, reinterpret_cast<std::uintptr_t>(p3) % 8);
+	std::memset(p3, 0, 200);
+
+	arena.release();
+}
+
+TEST(any_cow, inline_value)
+{
+	static_any_cow<16> a(7);
+	static_any_cow<16> b(a);
+
+	ASSERT_TRUE(a.stored_inline());
+	ASSERT_EQ(1, a.use_count());
+
+	b.get<int>() = 8;
+	ASSERT_EQ(7, a.get<int>());
+	ASSERT_EQ(8, b.get<int>());
+}
+
+TEST(any_cow, copy_shares_value)
+{
+	using Snapshot = std::array<int, 256>;
+
+	Snapshot snapshot{};
+	snapshot[0] = 42;
+
+	static_any_cow<16> a(snapshot);
+	ASSERT_FALSE(a.stored_inline());
+
+	static_any_cow<16> b(a);
+	static_any_cow<16> c;
+	c = b;
+
+	ASSERT_EQ(3, a.use_count());
+
+	const auto& const_a = a;
+	const auto& const_b = b;
+	ASSERT_EQ(&const_a.get<Snapshot>(), &const_b.get<Snapshot>());
+	ASSERT_EQ(3, a.use_count());
+
+	// mutable access makes a private copy
+	b.get<Snapshot>()[0] = 43;
+	ASSERT_EQ(2, a.use_count());
+	ASSERT_EQ(1, b.use_count());
+	ASSERT_EQ(42, const_a.get<Snapshot>()[0]);
+	ASSERT_EQ(43, const_b.get<Snapshot>()[0]);
+	ASSERT_NE(&const_a.get<Snapshot>(), &const_b.get<Snapshot>());
+
+	// not shared anymore: no copy
+	const Snapshot* private_copy = &b.get<Snapshot>();
+	ASSERT_EQ(private_copy, any_cast<Snapshot>(&b));
+
+	c.reset();
+	ASSERT_EQ(1, a.use_count());
+}
+
+TEST(any_cow, reference_outlives_copy)
+{
+	using Big = std::array<int, 64>;
+
+	static_any_cow<8> a(Big{});
+	Big& r = a.get<Big>();
+
+	// the value was handed out mutably: the copy doesn't share it
+	static_any_cow<8> b = a;
+	r[0] = 42;
+	EXPECT_EQ(42, a.get<Big>()[0]);
+	EXPECT_EQ(0, b.get<Big>()[0]);
+	EXPECT_EQ(1, a.use_count());
+	EXPECT_EQ(1, b.use_count());
+
+	// nor once moved to another container
+	static_any_cow<8> c = std::move(a);
+	static_any_cow<8> d = c;
+	r[0] = 43;
+	EXPECT_EQ(43, c.get<Big>()[0]);
+	EXPECT_EQ(42, d.get<Big>()[0]);
+
+	// assigned in place, the value stays private as r still refers to it
+	c = Big{};
+	static_any_cow<8> e = c;
+	EXPECT_EQ(1, e.use_count());
+
+	// a new block is shared again
+	c.emplace<Big>();
+	static_any_cow<8> f = c;
+	EXPECT_EQ(2, f.use_count());
+}
+
+TEST(any_cow, shared_value_destruction)
+{
+	struct BigCounter { CallCounter<0> counter; std::array<char, 64> c; };
+
+	CallCounter<0>::reset_counters();
+	{
+		static_any_cow<16> a;
+		a.emplace<BigCounter>();
+
+		static_any_cow<16> b(a);
+		static_any_cow<16> c(std::move(b));
+		ASSERT_TRUE(b.empty());
+		ASSERT_EQ(2, c.use_count());
+	}
+
+	EXPECT_EQ(1, CallCounter<0>::constructions);
+	EXPECT_EQ(0, CallCounter<0>::copy_constructions);
+	EXPECT_EQ(1, CallCounter<0>::destructions);
+}
+
+TEST(any_cow, assignment_to_shared_value)
+{
+	static_any_cow<8> a(std::string("Hello"));
+	static_any_cow<8> b(a);
+
+	b = std::string("world");
+	ASSERT_EQ("Hello", a.get<std::string>());
+	ASSERT_EQ("world", b.get<std::string>());
+	ASSERT_EQ(1, a.use_count());
+
+	EXPECT_ANY_ERROR(b.get<int>(), bad_any_cast);
+
+	static_any_cow<8> empty;
+	b = empty;
+	ASSERT_TRUE(b.empty());
+}
+
+TEST(any_of, layout)
+{
+	using any_of_t = static_any_of<int, float, char>;
+
+	static_assert(sizeof(any_of_t) == 8, "4 bytes for the biggest type and 1 byte for the index");
+	static_assert(alignof(any_of_t) == 4, "aligned as the most aligned type");
+	static_assert(std::is_trivially_copyable<any_of_t>::value, "all the types are trivially copyable");
+	static_assert(!std::is_trivially_copyable<static_any_of<int, std::string>>::value, "std::string is not");
+}
+
+TEST(any_of, assign_and_get)
+{
+	static_any_of<int, double, std::string> a;
+	ASSERT_TRUE(a.empty());
+	ASSERT_EQ(static_any_of<int>::npos, a.index());
+	ASSERT_EQ(typeid(void), a.type());
+
+	a = 7;
+	ASSERT_TRUE(a.has<int>());
+	ASSERT_FALSE(a.has<double>());
+	ASSERT_FALSE(a.has<char>());
+	ASSERT_EQ(0, a.index());
+	ASSERT_EQ(7, a.get<int>());
+	ASSERT_EQ(sizeof(int), a.size());
+
+	a = std::string("Hello");
+	ASSERT_EQ(2, a.index());
+	ASSERT_EQ(typeid(std::string), a.type());
+	ASSERT_EQ("Hello", any_cast<std::string>(a));
+	ASSERT_EQ(nullptr, any_cast<int>(&a));
+	EXPECT_ANY_ERROR(a.get<double>(), bad_any_cast);
+
+	a.emplace<double>(.5);
+	ASSERT_EQ(.5, a.get<double>());
+
+	a.reset();
+	ASSERT_TRUE(a.empty());
+}
+
+TEST(any_of, copy_move_destroy)
+{
+	CallCounter<0>::reset_counters();
+	{
+		static_any_of<int, CallCounter<0>> a;
+		a.emplace<CallCounter<0>>();
+
+		static_any_of<int, CallCounter<0>> b(a);
+		static_any_of<int, CallCounter<0>> c(std::move(b));
+		a = 7;
+		c = a;
+		ASSERT_EQ(7, c.get<int>());
+	}
+
+	EXPECT_EQ(1, CallCounter<0>::constructions);
+	EXPECT_EQ(1, CallCounter<0>::copy_constructions);
+	EXPECT_EQ(1, CallCounter<0>::move_constructions);
+	EXPECT_EQ(3, CallCounter<0>::destructions);
+}
+
+TEST(any_of, same_type_assignment_in_place)
+{
+	static_any_of<int, std::string> a = std::string(100, 'x');
+	const char* data = a.get<std::string>().data();
+
+	const std::string hello("Hello");
+	a = hello;
+	ASSERT_EQ(data, a.get<std::string>().data());
+}
+
+TEST(any_of, many_types)
+{
+	static_any_of<char, signed char, unsigned char, short, unsigned short, int, unsigned, long, unsigned long, std::string> a;
+
+	a = std::string("Hello");
+	ASSERT_EQ(9, a.index());
+	ASSERT_EQ(typeid(std::string), a.type());
+
+	auto b = a;
+	ASSERT_EQ("Hello", b.get<std::string>());
+
+	a = 7ul;
+	ASSERT_EQ(sizeof(unsigned long), a.size());
+}
+
+TEST(any_compact, layout)
+{
+	static_assert(sizeof(static_any_compact) == 8, "");
+
+	static_any_compact a;
+	ASSERT_TRUE(a.empty());
+	ASSERT_EQ(typeid(void), a.type());
+	ASSERT_EQ(0, a.size());
+}
+
+TEST(any_compact, doubles)
+{
+	static_any_compact a = 3.5;
+	ASSERT_TRUE(a.has<double>());
+	ASSERT_TRUE(a.stored_inline());
+	ASSERT_EQ(3.5, a.get<double>());
+	ASSERT_EQ(typeid(double), a.type());
+
+	a = -std::numeric_limits<double>::infinity();
+	ASSERT_EQ(-std::numeric_limits<double>::infinity(), any_cast<double>(a));
+
+	a = -0.0;
+	ASSERT_TRUE(std::signbit(a.get<double>()));
+
+	a = -std::numeric_limits<double>::quiet_NaN();
+	ASSERT_TRUE(a.has<double>());
+	ASSERT_TRUE(std::isnan(a.get<double>()));
+}
+
+TEST(any_compact, inline_values)
+{
+	static_any_compact a = 7;
+	ASSERT_TRUE(a.has<int>());
+	ASSERT_FALSE(a.has<unsigned>());
+	ASSERT_FALSE(a.has<float>());
+	ASSERT_TRUE(a.stored_inline());
+	ASSERT_EQ(7, a.get<int>());
+	ASSERT_EQ(sizeof(int), a.size());
+	ASSERT_EQ(typeid(int), a.type());
+
+	a = 2.5f;
+	ASSERT_EQ(2.5f, any_cast<float>(a));
+	a = true;
+	ASSERT_TRUE(a.get<bool>());
+
+	a = std::int64_t(-42);
+	ASSERT_TRUE(a.stored_inline());
+	ASSERT_EQ(-42, a.get<std::int64_t>());
+	ASSERT_FALSE(a.has<std::uint64_t>());
+	ASSERT_EQ(typeid(std::int64_t), a.type());
+
+	const char* str = "Hello";
+	a = str;
+	ASSERT_TRUE(a.stored_inline());
+	ASSERT_EQ(str, a.get<const char*>());
+	ASSERT_FALSE(a.has<char*>());
+}
+
+TEST(any_compact, cell_values)
+{
+	static_any_compact a = std::numeric_limits<std::int64_t>::min();
+	ASSERT_FALSE(a.stored_inline());
+	ASSERT_EQ(std::numeric_limits<std::int64_t>::min(), a.get<std::int64_t>());
+
+	a = std::string("Hello");
+	ASSERT_FALSE(a.stored_inline());
+	ASSERT_TRUE(a.has<std::string>());
+	a.get<std::string>() += " world";
+	ASSERT_EQ("Hello world", *any_cast<std::string>(&a));
+	ASSERT_EQ(nullptr, any_cast<std::vector<int>>(&a));
+
+	static_any_compact b = a;
+	ASSERT_NE(&a.get<std::string>(), &b.get<std::string>());
+	ASSERT_EQ("Hello world", b.get<std::string>());
+
+	static_any_compact c = std::move(b);
+	ASSERT_TRUE(b.empty());
+	ASSERT_EQ("Hello world", c.get<std::string>());
+
+	a.emplace<std::vector<int>>(3, 1);
+	ASSERT_EQ(3, a.get<std::vector<int>>().size());
+}
+
+TEST(any_compact, copy_move_destroy)
+{
+	CallCounter<0>::reset_counters();
+	{
+		static_any_compact a;
+		a.emplace<CallCounter<0>>();
+
+		static_any_compact b(a);
+		static_any_compact c(std::move(b));
+		a = 7;
+		c = a;
+		ASSERT_EQ(7, c.get<int>());
+	}
+
+	EXPECT_EQ(1, CallCounter<0>::constructions);
+	EXPECT_EQ(1, CallCounter<0>::copy_constructions);
+	EXPECT_EQ(0, CallCounter<0>::move_constructions);
+	EXPECT_EQ(2, CallCounter<0>::destructions);
+}
+
+enum class compact_enum : std::int64_t { value = -5 };
+struct compact_struct { short s; };
+
+TEST(any_compact, other_types_in_cells)
+{
+	static_any_compact a = compact_enum::value;
+	ASSERT_FALSE(a.stored_inline());
+	ASSERT_EQ(compact_enum::value, a.get<compact_enum>());
+	ASSERT_FALSE(a.has<std::int64_t>());
+
+	int i = 0;
+	a = &i;
+	ASSERT_FALSE(a.stored_inline());
+	ASSERT_EQ(&i, a.get<int*>());
+	ASSERT_FALSE(a.has<const int*>());
+
+	a = compact_struct{3};
+	ASSERT_FALSE(a.stored_inline());
+	ASSERT_EQ(3, a.get<compact_struct>().s);
+}
+
+TEST(any_compact, across_hidden_module)
+{
+	static_any_compact a = get_hidden_compact_with_int(7);
+	ASSERT_TRUE(a.stored_inline());
+	ASSERT_TRUE(a.has<int>());
+	ASSERT_FALSE(a.has<float>());
+	ASSERT_EQ(7, a.get<int>());
+	ASSERT_EQ(typeid(int), a.type());
+	ASSERT_EQ(type_id_of<int>(), a.type_id());
+
+	a = get_hidden_compact_with_string("Hello");
+	ASSERT_TRUE(a.has<std::string>());
+	ASSERT_EQ("Hello", a.get<std::string>());
+	ASSERT_EQ(type_id_of<std::string>(), a.type_id());
+}
+
+TEST(any_compact, bad_cast)
+{
+	static_any_compact a = 7;
+	EXPECT_ANY_ERROR(a.get<double>(), bad_any_cast);
+	EXPECT_ANY_ERROR(any_cast<std::string>(a), bad_any_cast);
+
+	a.reset();
+	EXPECT_ANY_ERROR(a.get<int>(), bad_any_cast);
+}
+
+TEST(type_id, dense_ids)
+{
+	const std::uint32_t int_id = type_id_of<int>();
+	const std::uint32_t string_id = type_id_of<std::string>();
+
+	EXPECT_EQ(0, type_id_of<void>());
+	EXPECT_NE(0, int_id);
+	EXPECT_NE(int_id, string_id);
+	EXPECT_EQ(int_id, type_id_of<const int>());
+
+	// assigned one after the other on first use
+	struct NewType {};
+	EXPECT_EQ(type_id_of<NewType>(), type_id_of<NewType>());
+	EXPECT_LT(type_id_of<NewType>(), 1000);
+}
+
+TEST(type_id, containers)
+{
+	static_any<32> a;
+	EXPECT_EQ(0, a.type_id());
+
+	a = 7;
+	EXPECT_EQ(type_id_of<int>(), a.type_id());
+
+	a = std::string("Hello");
+	EXPECT_EQ(type_id_of<std::string>(), a.type_id());
+
+	static_any_sbo<8> b = std::string("Hello");
+	EXPECT_EQ(type_id_of<std::string>(), b.type_id());
+
+	static_any_cow<8> c = 7;
+	EXPECT_EQ(type_id_of<int>(), c.type_id());
+
+	static_any_of<int, std::string> d = std::string("Hello");
+	EXPECT_EQ(type_id_of<std::string>(), d.type_id());
+}
+
+TEST(type_id, across_dll)
+{
+	auto a = get_any_with_int(7);
+	EXPECT_EQ(type_id_of<int>(), a.type_id());
+}
+
+TEST(type_id, across_hidden_module)
+{
+	// the module has its own registry, where int got another id
+	ASSERT_NE(type_id_of<int>(), hidden_lib_type_id_of_int());
+
+	auto a = get_hidden_any_with_int(7);
+	EXPECT_TRUE(a.has<int>());
+	EXPECT_EQ(type_id_of<int>(), a.type_id());
+	EXPECT_EQ(type_id_of<int>(), a.type_id());
+
+	auto b = get_hidden_any_with_string("Hello");
+	EXPECT_EQ(type_id_of<std::string>(), b.type_id());
+}
+
+TEST(visit, dispatch)
+{
+	auto visitor = make_visitor(
+		[](int i) { return "int " + std::to_string(i); },
+		[](const std::string& str) { return "string " + str; },
+		[](double) { return std::string("double"); },
+		[]() { return std::string("unknown"); });
+
+	static_any<32> a;
+	EXPECT_EQ("unknown", (visit<int, std::string, double>(a, visitor)));
+
+	a = 7;
+	EXPECT_EQ("int 7", (visit<int, std::string, double>(a, visitor)));
+
+	a = std::string("Hello");
+	EXPECT_EQ("string Hello", (visit<int, std::string, double>(a, visitor)));
+
+	a = .5;
+	EXPECT_EQ("double", (visit<int, std::string, double>(a, visitor)));
+
+	a = 'c';
+	EXPECT_EQ("unknown", (visit<int, std::string, double>(a, visitor)));
+}
+
+TEST(visit, mutable_and_const)
+{
+	static_any<32> a(std::string("Hello"));
+
+	visit<int, std::string>(a, make_visitor(
+		[](int& i) { i = 0; },
+		[](std::string& str) { str += " world"; },
+		[]() {}));
+	EXPECT_EQ("Hello world", a.get<std::string>());
+
+	const auto& const_a = a;
+	std::size_t size = visit<std::string>(const_a, make_visitor(
+		[](const std::string& str) { return str.size(); },
+		[]() { return std::size_t(0); }));
+	EXPECT_EQ(11, size);
+}
+
+TEST(visit, across_dll)
+{
+	auto a = get_any_with_int(7);
+
+	int value = visit<std::string, int>(a, make_visitor(
+		[](const std::string&) { return -1; },
+		[](int i) { return i; },
+		[]() { return -2; }));
+	EXPECT_EQ(7, value);
+}
+
+TEST(visit, across_hidden_module)
+{
+	auto visitor = make_visitor(
+		[](int i) { return "int " + std::to_string(i); },
+		[](const std::string& str) { return "string " + str; },
+		[](double) { return std::string("double"); },
+		[]() { return std::string("unknown"); });
+
+	EXPECT_EQ("int 7", (visit<int, std::string>(get_hidden_any_with_int(7), visitor)));
+	EXPECT_EQ("string Hello", (visit<int, std::string>(get_hidden_any_with_string("Hello"), visitor)));
+	EXPECT_EQ("unknown", (visit<double>(get_hidden_any_with_int(7), visitor)));
+}